@@ -0,0 +1,315 @@
+// Part of the Chili3d Project, under the LGPL-3.0 License.
+// See LICENSE-chili-wasm.text file in the project root for full license information.
+
+#include <BRepAlgoAPI_Cut.hxx>
+#include <BRepAlgoAPI_Defeaturing.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepMesh_IncrementalMesh.hxx>
+#include <BRepPrimAPI_MakeBox.hxx>
+#include <BRepPrimAPI_MakeCylinder.hxx>
+#include <BRepPrimAPI_MakeSphere.hxx>
+#include <BRepPrimAPI_MakeTorus.hxx>
+#include <BRepTools.hxx>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <OSD_ThreadPool.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+
+#include "bvh.hpp"
+#include "face_mesher.hpp"
+#include "transform.hpp"
+#include "vertex_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Prints one "name<TAB>milliseconds" line per case so scripts/bench_wasm.mjs can compare
+// the single-threaded and the pthread build on the same models.
+
+const int RUNS = 3;
+const double ANGLE_DEFLECTION = 0.2;
+
+double measure(const std::function<void()>& setup, const std::function<void()>& action)
+{
+    double best = 1e300;
+    for (int i = 0; i < RUNS; i++) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        action();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+void report(const char* name, double ms)
+{
+    std::printf("%s\t%.2f\n", name, ms);
+    std::fflush(stdout);
+}
+
+/// @brief A value that is not a time, prefixed with "ratio:" so the runner does not compare it as one.
+void reportRatio(const char* name, double ratio)
+{
+    std::printf("ratio:%s\t%.3f\n", name, ratio);
+    std::fflush(stdout);
+}
+
+/// @brief The index buffer of every triangulated face, with the vertex range it uses.
+struct FaceIndex {
+    std::vector<uint32_t> index;
+    uint32_t vertexCount;
+};
+
+std::vector<FaceIndex> faceIndices(const TopoDS_Shape& shape)
+{
+    std::vector<FaceIndex> result;
+    for (TopExp_Explorer explorer(shape, TopAbs_FACE); explorer.More(); explorer.Next()) {
+        TopLoc_Location location;
+        auto triangulation = BRep_Tool::Triangulation(TopoDS::Face(explorer.Current()), location);
+        if (triangulation.IsNull()) {
+            continue;
+        }
+        FaceIndex face { {}, static_cast<uint32_t>(triangulation->NbNodes()) };
+        for (int i = 1; i <= triangulation->NbTriangles(); i++) {
+            int n1, n2, n3;
+            triangulation->Triangle(i).Get(n1, n2, n3);
+            face.index.insert(face.index.end(), { uint32_t(n1 - 1), uint32_t(n2 - 1), uint32_t(n3 - 1) });
+        }
+        result.push_back(std::move(face));
+    }
+    return result;
+}
+
+double averageCacheMissRatio(const std::vector<FaceIndex>& faces, size_t cacheSize)
+{
+    double misses = 0, triangles = 0;
+    for (const auto& face : faces) {
+        misses += averageCacheMissRatio(face.index.data(), face.index.size(), cacheSize) * face.index.size() / 3;
+        triangles += face.index.size() / 3;
+    }
+    return triangles > 0 ? misses / triangles : 0;
+}
+
+/// @brief 9 floats per triangle of every triangulated face.
+std::vector<float> faceTriangles(const TopoDS_Shape& shape)
+{
+    std::vector<float> result;
+    for (TopExp_Explorer explorer(shape, TopAbs_FACE); explorer.More(); explorer.Next()) {
+        TopLoc_Location location;
+        auto triangulation = BRep_Tool::Triangulation(TopoDS::Face(explorer.Current()), location);
+        if (triangulation.IsNull()) {
+            continue;
+        }
+        for (int i = 1; i <= triangulation->NbTriangles(); i++) {
+            int n[3];
+            triangulation->Triangle(i).Get(n[0], n[1], n[2]);
+            for (int k = 0; k < 3; k++) {
+                auto pnt = triangulation->Node(n[k]).Transformed(location.Transformation());
+                result.insert(result.end(), { float(pnt.X()), float(pnt.Y()), float(pnt.Z()) });
+            }
+        }
+    }
+    return result;
+}
+
+TopoDS_Compound holeTools(int count, double pitch, double radius, double height)
+{
+    BRep_Builder builder;
+    TopoDS_Compound compound;
+    builder.MakeCompound(compound);
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < count; j++) {
+            gp_Ax2 axis(gp_Pnt((i + 0.5) * pitch, (j + 0.5) * pitch, -1), gp::DZ());
+            builder.Add(compound, BRepPrimAPI_MakeCylinder(axis, radius, height + 2).Shape());
+        }
+    }
+    return compound;
+}
+
+TopoDS_Compound roundParts(int count)
+{
+    BRep_Builder builder;
+    TopoDS_Compound compound;
+    builder.MakeCompound(compound);
+    for (int i = 0; i < count; i++) {
+        gp_Pnt center(i * 30.0, 0, 0);
+        builder.Add(compound, BRepPrimAPI_MakeSphere(center, 10).Shape());
+        builder.Add(compound, BRepPrimAPI_MakeTorus(gp_Ax2(center.Translated(gp_Vec(0, 30, 0)), gp::DZ()), 10, 3).Shape());
+    }
+    return compound;
+}
+
+/// @brief count * count cylinders of three faces each.
+TopoDS_Compound cylinderGrid(int count)
+{
+    BRep_Builder builder;
+    TopoDS_Compound compound;
+    builder.MakeCompound(compound);
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < count; j++) {
+            gp_Ax2 axis(gp_Pnt(i * 10.0, j * 10.0, 0), gp::DZ());
+            builder.Add(compound, BRepPrimAPI_MakeCylinder(axis, 3, 5).Shape());
+        }
+    }
+    return compound;
+}
+
+/// @brief Drops the normals FaceMesher left on the triangulations, so that every run computes them again.
+void removeNormals(const TopoDS_Shape& shape)
+{
+    for (TopExp_Explorer explorer(shape, TopAbs_FACE); explorer.More(); explorer.Next()) {
+        TopLoc_Location location;
+        auto triangulation = BRep_Tool::Triangulation(TopoDS::Face(explorer.Current()), location);
+        if (!triangulation.IsNull()) {
+            triangulation->RemoveNormals();
+        }
+    }
+}
+
+NCollection_List<TopoDS_Shape> cylindricalFaces(const TopoDS_Shape& shape)
+{
+    NCollection_List<TopoDS_Shape> faces;
+    for (TopExp_Explorer explorer(shape, TopAbs_FACE); explorer.More(); explorer.Next()) {
+        BRepAdaptor_Surface surface(TopoDS::Face(explorer.Current()));
+        if (surface.GetType() == GeomAbs_Cylinder) {
+            faces.Append(explorer.Current());
+        }
+    }
+    return faces;
+}
+
+int main()
+{
+    std::printf("threads\t%d\n", OSD_ThreadPool::DefaultPool()->NbThreads());
+
+    const int holes = 20;
+    const double pitch = 10;
+    TopoDS_Shape plate = BRepPrimAPI_MakeBox(holes * pitch, holes * pitch, 10).Shape();
+    TopoDS_Shape tools = holeTools(holes, pitch, 3, 10);
+
+    TopoDS_Shape drilled;
+    report("boolean-cut-400-holes", measure([] {}, [&] {
+        BRepAlgoAPI_Cut cut;
+        NCollection_List<TopoDS_Shape> args, toolList;
+        args.Append(plate);
+        toolList.Append(tools);
+        cut.SetArguments(args);
+        cut.SetTools(toolList);
+        cut.SetRunParallel(true);
+        cut.Build();
+        drilled = cut.Shape();
+    }));
+
+    report("mesh-drilled-plate", measure([&] { BRepTools::Clean(drilled); }, [&] {
+        BRepMesh_IncrementalMesh mesh(drilled, 0.001, true, ANGLE_DEFLECTION, true);
+    }));
+
+    TopoDS_Shape parts = roundParts(200);
+    report("mesh-400-round-parts", measure([&] { BRepTools::Clean(parts); }, [&] {
+        BRepMesh_IncrementalMesh mesh(parts, 0.0005, true, ANGLE_DEFLECTION, true);
+    }));
+
+    // FaceMesher::meshShape on a triangulated model, the extraction chili-wasm-mt spreads over its threads.
+    TopoDS_Shape cylinders = cylinderGrid(58);
+    BRepMesh_IncrementalMesh cylinderMesh(cylinders, 0.01, true, ANGLE_DEFLECTION, true);
+    report("extract-10k-faces", measure([&] { removeNormals(cylinders); }, [&] {
+        FaceMesher mesher;
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+        mesher.meshShape(cylinders, facePolyMap);
+    }));
+
+    // ACMR of a FIFO of the size optimizeVertexCache optimizes for, over the faces of the round parts as
+    // BRepMesh ordered them and after the Forsyth reordering of FaceMesher::optimizeVertexCache.
+    auto faces = faceIndices(parts);
+    reportRatio("acmr-brepmesh", averageCacheMissRatio(faces, VERTEX_CACHE_SIZE));
+    std::vector<FaceIndex> optimized;
+    report("vertex-cache-optimize", measure([&] { optimized = faces; }, [&] {
+        for (auto& face : optimized) {
+            optimizeVertexCache(face.index.data(), face.index.size(), 0, face.vertexCount);
+            optimizeVertexFetch(face.index.data(), face.index.size(), 0, face.vertexCount);
+        }
+    }));
+    reportRatio("acmr-optimized", averageCacheMissRatio(optimized, VERTEX_CACHE_SIZE));
+
+    // The rays of bvh-raycast-1000 and brute-raycast-1000 cross the row of round parts lengthwise.
+    auto triangles = faceTriangles(parts);
+    size_t triangleCount = triangles.size() / 9;
+    std::vector<BvhBox> boxes(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        for (int k = 0; k < 3; k++) {
+            boxes[i].grow(triangles.data() + i * 9 + k * 3);
+        }
+    }
+    Bvh bvh;
+    report("bvh-build-round-parts", measure([] {}, [&] { bvh.build(boxes); }));
+    auto raycast = [&](bool useBvh) {
+        for (int r = 0; r < 1000; r++) {
+            float origin[3] = { -20, -15 + r * 0.06f, 0.5f }, direction[3] = { 1, 0, 0.001f };
+            BvhRay ray(origin, direction);
+            float nearest = std::numeric_limits<float>::infinity();
+            auto visit = [&](uint32_t i) {
+                const float* p = triangles.data() + i * 9;
+                float t, u, v;
+                if (intersectTriangle(ray, p, p + 3, p + 6, t, u, v) && t < nearest) {
+                    nearest = t;
+                }
+                return nearest;
+            };
+            if (useBvh) {
+                bvh.traverse([&](const BvhBox& box) { return ray.enter(box, 0, nearest); }, visit);
+            } else {
+                for (uint32_t i = 0; i < triangleCount; i++) {
+                    visit(i);
+                }
+            }
+        }
+    };
+    report("bvh-raycast-1000", measure([] {}, [&] { raycast(true); }));
+    report("brute-raycast-1000", measure([] {}, [&] { raycast(false); }));
+
+    auto holeFaces = cylindricalFaces(drilled);
+    report("defeature-400-holes", measure([] {}, [&] {
+        BRepAlgoAPI_Defeaturing defeaturing;
+        defeaturing.SetShape(drilled);
+        defeaturing.AddFacesToRemove(holeFaces);
+        defeaturing.SetRunParallel(true);
+        defeaturing.Build();
+    }));
+
+    const size_t nodes = 1 << 20;
+    std::vector<double> points(nodes * 3);
+    std::vector<float> normals(nodes * 3), output(nodes * 3);
+    for (size_t i = 0; i < nodes * 3; i++) {
+        points[i] = static_cast<double>(i % 1000) * 0.1;
+        normals[i] = static_cast<float>(i % 3 == 2);
+    }
+    gp_Trsf trsf;
+    trsf.SetRotation(gp_Ax1(gp::Origin(), gp_Dir(1, 1, 1)), 0.3);
+    trsf.SetTranslationPart(gp_Vec(10, 20, 30));
+    AffineTransform transform(trsf);
+    report("transform-points-scalar", measure([] {}, [&] {
+        transformPointsScalar(transform, points.data(), nodes, output.data());
+    }));
+    report("transform-points", measure([] {}, [&] {
+        transformPoints(transform, points.data(), nodes, output.data());
+    }));
+    report("transform-points-identity", measure([] {}, [&] {
+        transformPoints(AffineTransform(gp_Trsf()), points.data(), nodes, output.data());
+    }));
+    report("transform-normals-scalar", measure([] {}, [&] {
+        transformNormalsScalar(transform, normals.data(), nodes, true, output.data());
+    }));
+    report("transform-normals", measure([] {}, [&] {
+        transformNormals(transform, normals.data(), nodes, true, output.data());
+    }));
+
+    return 0;
+}
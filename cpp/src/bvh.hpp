@@ -0,0 +1,382 @@
+// Part of the Chili3d Project, under the LGPL-3.0 License.
+// See LICENSE-chili-wasm.text file in the project root for full license information.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+struct BvhBox {
+    std::array<float, 3> min { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::infinity() };
+    std::array<float, 3> max { -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity() };
+
+    void grow(const float* point)
+    {
+        for (int i = 0; i < 3; i++) {
+            min[i] = std::min(min[i], point[i]);
+            max[i] = std::max(max[i], point[i]);
+        }
+    }
+
+    void grow(const BvhBox& other)
+    {
+        for (int i = 0; i < 3; i++) {
+            min[i] = std::min(min[i], other.min[i]);
+            max[i] = std::max(max[i], other.max[i]);
+        }
+    }
+
+    bool isEmpty() const
+    {
+        return min[0] > max[0];
+    }
+
+    /// @brief Half the surface area, enough for the ratios of the SAH.
+    float area() const
+    {
+        if (isEmpty()) {
+            return 0;
+        }
+        float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+        return x * y + y * z + z * x;
+    }
+
+    float center(int axis) const
+    {
+        return (min[axis] + max[axis]) * 0.5f;
+    }
+};
+
+/// @brief count is 0 for inner nodes, whose children are the adjacent nodes start and start + 1.
+/// Leaves own primitives[start, start + count).
+struct BvhNode {
+    BvhBox box;
+    uint32_t start;
+    uint32_t count;
+};
+
+/// @brief A binned SAH bounding volume hierarchy over primitives given by their boxes. It only orders
+/// the primitives, the caller keeps the geometry and tests it in the visitors of traverse.
+class Bvh {
+public:
+    static constexpr int BIN_COUNT = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 8;
+    /// @brief Cost of visiting a node, relative to testing one primitive.
+    static constexpr float TRAVERSAL_COST = 1.0f;
+
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> primitives;
+
+    void build(const std::vector<BvhBox>& boxes)
+    {
+        nodes.clear();
+        primitives.resize(boxes.size());
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            primitives[i] = i;
+        }
+        if (boxes.empty()) {
+            return;
+        }
+
+        nodes.reserve(boxes.size() * 2 / MAX_LEAF_SIZE + 1);
+        nodes.push_back(BvhNode { {}, 0, static_cast<uint32_t>(boxes.size()) });
+        std::vector<uint32_t> stack { 0 };
+        while (!stack.empty()) {
+            uint32_t nodeIndex = stack.back();
+            stack.pop_back();
+            uint32_t start = nodes[nodeIndex].start, count = nodes[nodeIndex].count;
+            for (uint32_t i = start; i < start + count; i++) {
+                nodes[nodeIndex].box.grow(boxes[primitives[i]]);
+            }
+
+            uint32_t middle = split(boxes, nodes[nodeIndex]);
+            if (middle == start || middle == start + count) {
+                continue;
+            }
+            uint32_t left = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(BvhNode { {}, start, middle - start });
+            nodes.push_back(BvhNode { {}, middle, start + count - middle });
+            nodes[nodeIndex].start = left;
+            nodes[nodeIndex].count = 0;
+            stack.push_back(left + 1);
+            stack.push_back(left);
+        }
+    }
+
+    /// @brief Depth first, nearer child first. enter returns the entry distance of a box, infinity to
+    /// skip it, visit tests a primitive and returns the distance from which on nothing matters any more,
+    /// infinity for queries that collect everything.
+    template <typename Enter, typename Visit>
+    void traverse(Enter enter, Visit visit) const
+    {
+        if (nodes.empty()) {
+            return;
+        }
+        float limit = std::numeric_limits<float>::infinity();
+        float rootEntry = enter(nodes[0].box);
+        if (!(rootEntry < limit)) {
+            return;
+        }
+        std::vector<std::pair<uint32_t, float>> stack { { 0, rootEntry } };
+        while (!stack.empty()) {
+            auto [nodeIndex, entry] = stack.back();
+            stack.pop_back();
+            if (entry >= limit) {
+                continue;
+            }
+            const auto& node = nodes[nodeIndex];
+            if (node.count > 0) {
+                for (uint32_t i = node.start; i < node.start + node.count; i++) {
+                    limit = std::min(limit, visit(primitives[i]));
+                }
+                continue;
+            }
+
+            uint32_t near = node.start, far = node.start + 1;
+            float nearEntry = enter(nodes[near].box), farEntry = enter(nodes[far].box);
+            if (farEntry < nearEntry) {
+                std::swap(near, far);
+                std::swap(nearEntry, farEntry);
+            }
+            if (farEntry < limit) {
+                stack.push_back({ far, farEntry });
+            }
+            if (nearEntry < limit) {
+                stack.push_back({ near, nearEntry });
+            }
+        }
+    }
+
+private:
+    /// @brief Partitions the primitives of a node at the cheapest of the bin borders on all axes and
+    /// returns the first primitive of the right half, start or start + count to keep the node a leaf.
+    uint32_t split(const std::vector<BvhBox>& boxes, const BvhNode& node)
+    {
+        uint32_t start = node.start, count = node.count;
+        if (count <= 2) {
+            return start;
+        }
+
+        BvhBox centers;
+        for (uint32_t i = start; i < start + count; i++) {
+            const auto& box = boxes[primitives[i]];
+            float center[3] = { box.center(0), box.center(1), box.center(2) };
+            centers.grow(center);
+        }
+
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestAxis = -1, bestBin = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centers.max[axis] - centers.min[axis];
+            if (!(extent > 0)) {
+                continue;
+            }
+            BvhBox binBoxes[BIN_COUNT];
+            uint32_t binCounts[BIN_COUNT] = {};
+            float scale = BIN_COUNT / extent;
+            for (uint32_t i = start; i < start + count; i++) {
+                const auto& box = boxes[primitives[i]];
+                int bin = std::min(BIN_COUNT - 1, static_cast<int>((box.center(axis) - centers.min[axis]) * scale));
+                binBoxes[bin].grow(box);
+                binCounts[bin]++;
+            }
+
+            float rightAreas[BIN_COUNT];
+            uint32_t rightCounts[BIN_COUNT];
+            BvhBox right;
+            uint32_t rightCount = 0;
+            for (int bin = BIN_COUNT - 1; bin > 0; bin--) {
+                right.grow(binBoxes[bin]);
+                rightCount += binCounts[bin];
+                rightAreas[bin] = right.area();
+                rightCounts[bin] = rightCount;
+            }
+            BvhBox left;
+            uint32_t leftCount = 0;
+            for (int bin = 1; bin < BIN_COUNT; bin++) {
+                left.grow(binBoxes[bin - 1]);
+                leftCount += binCounts[bin - 1];
+                if (leftCount == 0 || rightCounts[bin] == 0) {
+                    continue;
+                }
+                float cost = left.area() * leftCount + rightAreas[bin] * rightCounts[bin];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        float leafCost = node.box.area() * count;
+        bestCost += TRAVERSAL_COST * node.box.area();
+        if (bestAxis < 0 || (bestCost >= leafCost && count <= MAX_LEAF_SIZE)) {
+            return start;
+        }
+
+        float scale = BIN_COUNT / (centers.max[bestAxis] - centers.min[bestAxis]);
+        auto middle = std::partition(primitives.begin() + start, primitives.begin() + start + count, [&](uint32_t p) {
+            int bin = static_cast<int>((boxes[p].center(bestAxis) - centers.min[bestAxis]) * scale);
+            return std::min(BIN_COUNT - 1, bin) < bestBin;
+        });
+        return static_cast<uint32_t>(middle - primitives.begin());
+    }
+};
+
+/// @brief A ray with the reciprocal direction the slab test needs. direction does not have to be unit
+/// length, distances along it are in multiples of its length.
+struct BvhRay {
+    float origin[3];
+    float direction[3];
+    float inverse[3];
+
+    BvhRay(const float* origin, const float* direction)
+    {
+        for (int i = 0; i < 3; i++) {
+            this->origin[i] = origin[i];
+            this->direction[i] = direction[i];
+            this->inverse[i] = 1.0f / direction[i];
+        }
+    }
+
+    /// @brief The distance where the ray enters the box grown by margin, infinity when it misses it. A
+    /// negative minDistance extends the ray backwards, down to the whole line.
+    float enter(const BvhBox& box, float margin, float maxDistance, float minDistance = 0) const
+    {
+        float near = minDistance, far = maxDistance;
+        for (int i = 0; i < 3; i++) {
+            float t1 = (box.min[i] - margin - origin[i]) * inverse[i];
+            float t2 = (box.max[i] + margin - origin[i]) * inverse[i];
+            // written so that the NaN of a ray in the plane of a slab keeps the other bound
+            near = std::max(near, std::min(t1, t2));
+            far = std::min(far, std::max(t1, t2));
+        }
+        return near <= far ? near : std::numeric_limits<float>::infinity();
+    }
+};
+
+/// @brief Möller-Trumbore, front and back faces alike. Returns the distance and the barycentrics of
+/// the second and third corner.
+inline bool intersectTriangle(const BvhRay& ray, const float* p0, const float* p1, const float* p2, float& t,
+    float& u, float& v)
+{
+    float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    const float* d = ray.direction;
+    float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+    float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (std::abs(det) < std::numeric_limits<float>::min()) {
+        return false;
+    }
+    float inv = 1.0f / det;
+    float s[3] = { ray.origin[0] - p0[0], ray.origin[1] - p0[1], ray.origin[2] - p0[2] };
+    u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+    if (u < 0 || u > 1) {
+        return false;
+    }
+    float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+    v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+    if (v < 0 || u + v > 1) {
+        return false;
+    }
+    t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+    return t >= 0;
+}
+
+/// @brief The closest points of the ray and the segment ab: t along the ray, s in [0, 1] along the
+/// segment. Returns their squared distance.
+inline float closestRaySegment(const BvhRay& ray, const float* a, const float* b, float& t, float& s)
+{
+    const float* d1 = ray.direction;
+    float d2[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float w[3] = { ray.origin[0] - a[0], ray.origin[1] - a[1], ray.origin[2] - a[2] };
+    float aa = d1[0] * d1[0] + d1[1] * d1[1] + d1[2] * d1[2];
+    float ab = d1[0] * d2[0] + d1[1] * d2[1] + d1[2] * d2[2];
+    float bb = d2[0] * d2[0] + d2[1] * d2[1] + d2[2] * d2[2];
+    float aw = d1[0] * w[0] + d1[1] * w[1] + d1[2] * w[2];
+    float bw = d2[0] * w[0] + d2[1] * w[1] + d2[2] * w[2];
+
+    float denominator = aa * bb - ab * ab;
+    s = denominator > std::numeric_limits<float>::epsilon() * aa * bb ? (aa * bw - ab * aw) / denominator : 0;
+    s = std::clamp(s, 0.0f, 1.0f);
+    t = (ab * s - aw) / aa;
+    if (t < 0) {
+        t = 0;
+        s = bb > 0 ? std::clamp(bw / bb, 0.0f, 1.0f) : 0;
+    }
+
+    float dx = w[0] + d1[0] * t - d2[0] * s, dy = w[1] + d1[1] * t - d2[1] * s, dz = w[2] + d1[2] * t - d2[2] * s;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/// @brief Planes as a,b,c,d with ax + by + cz + d >= 0 on the inner side, six of them for a frustum or
+/// a box.
+struct BvhPlanes {
+    std::vector<float> planes;
+
+    bool isOutside(const BvhBox& box) const
+    {
+        for (size_t i = 0; i + 3 < planes.size(); i += 4) {
+            const float* p = planes.data() + i;
+            // the corner farthest along the normal
+            float x = p[0] >= 0 ? box.max[0] : box.min[0];
+            float y = p[1] >= 0 ? box.max[1] : box.min[1];
+            float z = p[2] >= 0 ? box.max[2] : box.min[2];
+            if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool contains(const float* point) const
+    {
+        for (size_t i = 0; i + 3 < planes.size(); i += 4) {
+            const float* p = planes.data() + i;
+            if (p[0] * point[0] + p[1] * point[1] + p[2] * point[2] + p[3] < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Whether a triangle or a segment of count points shares a point with the volume. The
+    /// primitive is clipped against the planes one after the other and hits when something is left.
+    bool intersects(const float* const* points, int count) const
+    {
+        std::vector<std::array<double, 3>> polygon, clipped;
+        for (int k = 0; k < count; k++) {
+            polygon.push_back({ points[k][0], points[k][1], points[k][2] });
+        }
+        for (size_t i = 0; i + 3 < planes.size() && !polygon.empty(); i += 4) {
+            const float* p = planes.data() + i;
+            auto distance = [p](const std::array<double, 3>& q) {
+                return p[0] * q[0] + p[1] * q[1] + p[2] * q[2] + p[3];
+            };
+            clipped.clear();
+            // A segment is a polygon of two points, its closing edge just repeats the crossing.
+            for (size_t k = 0; k < polygon.size(); k++) {
+                const auto& a = polygon[k];
+                const auto& b = polygon[(k + 1) % polygon.size()];
+                double da = distance(a), db = distance(b);
+                if (da >= 0) {
+                    clipped.push_back(a);
+                }
+                if ((da < 0) != (db < 0)) {
+                    double t = da / (da - db);
+                    clipped.push_back({ a[0] + (b[0] - a[0]) * t, a[1] + (b[1] - a[1]) * t, a[2] + (b[2] - a[2]) * t });
+                }
+            }
+            std::swap(polygon, clipped);
+        }
+        return !polygon.empty();
+    }
+};
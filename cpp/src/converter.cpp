@@ -39,20 +39,6 @@ public:
     }
 };
 
-EMSCRIPTEN_DECLARE_VAL_TYPE(ShapeNodeArray)
-
-struct ShapeNode {
-    std::optional<TopoDS_Shape> shape;
-    std::optional<std::string> color;
-    std::vector<ShapeNode> children;
-    std::string name;
-
-    ShapeNodeArray getChildren() const
-    {
-        return ShapeNodeArray(val::array(children));
-    }
-};
-
 // copy from https://github.com/kovacsv/occt-import-js/blob/main/occt-import-js/src/importer-xcaf.cpp
 std::string getLabelNameNoRef(const TDF_Label& label)
 {
@@ -0,0 +1,219 @@
+// Part of the Chili3d Project, under the LGPL-3.0 License.
+// See LICENSE-chili-wasm.text file in the project root for full license information.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Sum of squared distances to a set of planes, as the upper half of a symmetric 4x4 matrix, and
+/// the number of planes summed.
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+    double planes = 0;
+
+    void addPlane(double a, double b, double c, double d)
+    {
+        xx += a * a, xy += a * b, xz += a * c, xw += a * d;
+        yy += b * b, yz += b * c, yw += b * d;
+        zz += c * c, zw += c * d;
+        ww += d * d;
+        planes += 1;
+    }
+
+    void add(const Quadric& other)
+    {
+        xx += other.xx, xy += other.xy, xz += other.xz, xw += other.xw;
+        yy += other.yy, yz += other.yz, yw += other.yw;
+        zz += other.zz, zw += other.zw;
+        ww += other.ww;
+        planes += other.planes;
+    }
+
+    double error(const float* p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        return xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x + yy * y * y + 2 * yz * y * z + 2 * yw * y
+            + zz * z * z + 2 * zw * z + ww;
+    }
+
+    /// @brief Mean squared distance to the planes, which unlike error does not grow with every plane merged.
+    double meanError(const float* p) const
+    {
+        return planes > 0 ? std::max(error(p), 0.0) / planes : 0;
+    }
+};
+
+/// @brief Quadric error simplification of one triangle list by half-edge collapses: a vertex moves onto
+/// a neighbour, so the kept vertices keep their position, normal and uv. Vertices on open edges, where
+/// the triangulation of a face ends, never move, nor do those flagged in locked. Collapses are ordered by
+/// the mean squared distance of the moved vertex to the planes of the triangles merged into it. It stops
+/// at targetIndexCount indices or when the root of that mean would exceed maxError, 0 for no limit; a
+/// single plane far off can hide in the mean, so maxError bounds the typical deviation, not the largest.
+/// Returns the remaining triangles with the indices of the input.
+inline std::vector<uint32_t> simplifyTriangles(const float* position, uint32_t vertexCount, const uint32_t* index,
+    size_t indexCount, std::vector<bool> locked, size_t targetIndexCount, double maxError)
+{
+    size_t triangleCount = indexCount / 3;
+    std::vector<std::array<uint32_t, 3>> triangles(triangleCount);
+    std::vector<bool> removed(triangleCount, false);
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+    std::vector<Quadric> quadrics(vertexCount);
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    auto edgeKey = [](uint32_t a, uint32_t b) { return (uint64_t(std::min(a, b)) << 32) | std::max(a, b); };
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangles[t] = { index[t * 3], index[t * 3 + 1], index[t * 3 + 2] };
+        const float* p0 = position + triangles[t][0] * 3;
+        const float* p1 = position + triangles[t][1] * 3;
+        const float* p2 = position + triangles[t][2] * 3;
+        double ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+        double vx = p2[0] - p0[0], vy = p2[1] - p0[1], vz = p2[2] - p0[2];
+        double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+        double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+        if (length > 0) {
+            nx /= length, ny /= length, nz /= length;
+            Quadric plane;
+            plane.addPlane(nx, ny, nz, -(nx * p0[0] + ny * p0[1] + nz * p0[2]));
+            for (auto v : triangles[t]) {
+                quadrics[v].add(plane);
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            vertexTriangles[triangles[t][k]].push_back(t);
+            edgeUses[edgeKey(triangles[t][k], triangles[t][(k + 1) % 3])]++;
+        }
+    }
+    for (const auto& [key, uses] : edgeUses) {
+        if (uses == 1) {
+            locked[key >> 32] = true;
+            locked[key & 0xFFFFFFFF] = true;
+        }
+    }
+
+    struct Collapse {
+        double cost;
+        uint32_t from, to, fromStamp, toStamp;
+        bool operator<(const Collapse& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    std::priority_queue<Collapse> queue;
+    auto pushCollapses = [&](uint32_t v) {
+        for (auto t : vertexTriangles[v]) {
+            if (removed[t]) {
+                continue;
+            }
+            for (auto other : triangles[t]) {
+                if (other == v) {
+                    continue;
+                }
+                Quadric sum = quadrics[v];
+                sum.add(quadrics[other]);
+                if (!locked[v]) {
+                    queue.push({ sum.meanError(position + other * 3), v, other, stamps[v], stamps[other] });
+                }
+                if (!locked[other]) {
+                    queue.push({ sum.meanError(position + v * 3), other, v, stamps[other], stamps[v] });
+                }
+            }
+        }
+    };
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        pushCollapses(v);
+    }
+
+    auto normal = [&](uint32_t a, uint32_t b, uint32_t c) {
+        const float *p0 = position + a * 3, *p1 = position + b * 3, *p2 = position + c * 3;
+        double ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+        double vx = p2[0] - p0[0], vy = p2[1] - p0[1], vz = p2[2] - p0[2];
+        return std::array<double, 3> { uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx };
+    };
+    auto neighbours = [&](uint32_t v) {
+        std::vector<uint32_t> result;
+        for (auto t : vertexTriangles[v]) {
+            if (!removed[t]) {
+                result.insert(result.end(), triangles[t].begin(), triangles[t].end());
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    };
+    // The collapse must not fold a triangle over, and a and b may only share the neighbours of the
+    // triangles on their common edge, otherwise the surface would pinch into a non-manifold edge.
+    auto canCollapse = [&](uint32_t a, uint32_t b) {
+        size_t shared = 0;
+        for (auto t : vertexTriangles[a]) {
+            if (removed[t]) {
+                continue;
+            }
+            const auto& tri = triangles[t];
+            if (tri[0] == b || tri[1] == b || tri[2] == b) {
+                shared++;
+                continue;
+            }
+            auto before = normal(tri[0], tri[1], tri[2]);
+            auto after = normal(tri[0] == a ? b : tri[0], tri[1] == a ? b : tri[1], tri[2] == a ? b : tri[2]);
+            if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0) {
+                return false;
+            }
+        }
+        auto na = neighbours(a), nb = neighbours(b);
+        std::vector<uint32_t> common;
+        std::set_intersection(na.begin(), na.end(), nb.begin(), nb.end(), std::back_inserter(common));
+        return common.size() <= shared + 2;
+    };
+
+    size_t remaining = triangleCount;
+    double maxCost = maxError > 0 ? maxError * maxError : std::numeric_limits<double>::infinity();
+    while (remaining * 3 > targetIndexCount && !queue.empty()) {
+        auto collapse = queue.top();
+        queue.pop();
+        if (collapse.cost > maxCost) {
+            break;
+        }
+        uint32_t a = collapse.from, b = collapse.to;
+        if (stamps[a] != collapse.fromStamp || stamps[b] != collapse.toStamp || !canCollapse(a, b)) {
+            continue;
+        }
+
+        for (auto t : vertexTriangles[a]) {
+            if (removed[t]) {
+                continue;
+            }
+            auto& tri = triangles[t];
+            if (tri[0] == b || tri[1] == b || tri[2] == b) {
+                removed[t] = true;
+                remaining--;
+                continue;
+            }
+            std::replace(tri.begin(), tri.end(), a, b);
+            vertexTriangles[b].push_back(t);
+        }
+        vertexTriangles[a].clear();
+        quadrics[b].add(quadrics[a]);
+        stamps[a]++;
+        stamps[b]++;
+        pushCollapses(b);
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(remaining * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (!removed[t]) {
+            result.insert(result.end(), triangles[t].begin(), triangles[t].end());
+        }
+    }
+    return result;
+}
@@ -0,0 +1,519 @@
+// Part of the Chili3d Project, under the LGPL-3.0 License.
+// See LICENSE-chili-wasm.text file in the project root for full license information.
+
+#pragma once
+
+#include <BRepLib_ToolTriangulatedShape.hxx>
+#include <BRepTools.hxx>
+#include <BRep_Tool.hxx>
+#include <GeomAdaptor_Surface.hxx>
+#include <NCollection_IndexedMap.hxx>
+#include <OSD_Parallel.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopLoc_Location.hxx>
+#include <TopTools_ShapeMapHasher.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Face.hxx>
+#include <TopoDS_Shape.hxx>
+#include <gp_Trsf.hxx>
+#include <gp_Vec3f.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "decimate.hpp"
+#include "transform.hpp"
+#include "vertex_cache.hpp"
+
+// Face buffers of triangulated shapes. They do not depend on embind, so chili-bench can run them too.
+
+inline uint16_t quantizeUnorm16(double value)
+{
+    value = value > 0 ? std::min(value, 1.0) : 0;
+    return static_cast<uint16_t>(std::lround(value * 65535));
+}
+
+inline int8_t quantizeSnorm8(double value)
+{
+    value = value > -1 ? std::min(value, 1.0) : -1;
+    return static_cast<int8_t>(std::lround(value * 127));
+}
+
+inline int16_t quantizeSnorm16(double value)
+{
+    value = value > -1 ? std::min(value, 1.0) : -1;
+    return static_cast<int16_t>(std::lround(value * 32767));
+}
+
+/// @brief Octahedral encoding: the unit vector is projected onto the octahedron |x|+|y|+|z|=1,
+/// whose lower half is folded over the upper one, and stored as its x and y.
+inline std::pair<double, double> octahedral(double x, double y, double z)
+{
+    double length = std::abs(x) + std::abs(y) + std::abs(z);
+    double u = 0, v = 0;
+    if (length > 0) {
+        u = x / length;
+        v = y / length;
+        if (z < 0) {
+            double foldedU = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+            double foldedV = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+            u = foldedU;
+            v = foldedV;
+        }
+    }
+    return { u, v };
+}
+
+inline void appendOctahedral(double x, double y, double z, std::vector<int8_t>& normal)
+{
+    auto [u, v] = octahedral(x, y, z);
+    normal.push_back(quantizeSnorm8(u));
+    normal.push_back(quantizeSnorm8(v));
+}
+
+/// @brief Vertex layouts of FaceMesher::interleave. Interleaved is position, normal and uv as floats,
+/// 32 bytes. Packed keeps the float position and stores an octahedral snorm16x2 normal and an unorm16x2
+/// uv, 20 bytes.
+enum class VertexLayout {
+    Separate,
+    Interleaved,
+    Packed,
+};
+
+/// @brief Group-local indices: a group spanning fewer than 65536 vertices goes to index16, the others
+/// to index32. The base vertex of the group has to be added to its indices.
+struct GroupIndex {
+    std::vector<uint16_t> index16;
+    std::vector<uint32_t> index32;
+    /// @brief baseVertex,vertexCount,indexStart,indexCount per group, indexStart counted in the buffer
+    /// the vertex count selects
+    std::vector<uint32_t> indexGroup;
+
+    void build(const std::vector<uint32_t>& index, const std::vector<uint32_t>& group)
+    {
+        for (size_t i = 0; i + 1 < group.size(); i += 2) {
+            auto begin = index.begin() + group[i];
+            auto end = begin + group[i + 1];
+            uint32_t baseVertex = 0;
+            uint32_t vertexCount = 0;
+            if (begin != end) {
+                auto [min, max] = std::minmax_element(begin, end);
+                baseVertex = *min;
+                vertexCount = *max - *min + 1;
+            }
+
+            // WebGL 2 always restarts primitives at 0xFFFF, so that index is left out
+            bool is16 = vertexCount < 65536;
+            indexGroup.push_back(baseVertex);
+            indexGroup.push_back(vertexCount);
+            indexGroup.push_back(is16 ? index16.size() : index32.size());
+            indexGroup.push_back(group[i + 1]);
+            for (auto it = begin; it != end; it++) {
+                if (is16) {
+                    index16.push_back(*it - baseVertex);
+                } else {
+                    index32.push_back(*it - baseVertex);
+                }
+            }
+        }
+    }
+};
+
+class FaceMesher {
+    /// @brief Where one face lands in the buffers, in vertices and in index entries.
+    struct FaceSlice {
+        TopoDS_Face face;
+        Handle(Poly_Triangulation) handlePoly;
+        gp_Trsf trsf;
+        size_t vertexStart;
+        size_t indexStart;
+    };
+
+public:
+    std::vector<float> position;
+    std::vector<float> normal;
+    std::vector<float> uv;
+    std::vector<uint32_t> index;
+    /// @brief start1,count1,start2,count2...
+    std::vector<uint32_t> group;
+    std::vector<TopoDS_Face> faces;
+    GroupIndex groupIndex;
+    /// @brief Filled instead of position, normal and uv by meshShape when layout is not Separate, or by
+    /// interleave, vertexStride bytes per vertex.
+    std::vector<uint8_t> vertices;
+    uint32_t vertexStride = 0;
+    /// @brief Set before meshShape to fill the vertices straight into vertices. decimate needs the
+    /// separate buffers, so it is meshed with Separate and interleaved afterwards.
+    VertexLayout layout = VertexLayout::Separate;
+
+    /// @brief Moves the indices into groupIndex, index is empty afterwards.
+    void compactIndex()
+    {
+        groupIndex.build(index, group);
+        index = std::vector<uint32_t>();
+    }
+
+    /// @brief Simplifies every face group to about ratio of its triangles with simplifyTriangles, stopping
+    /// earlier once a collapse would move a vertex by more than maxError root mean square from the planes
+    /// of the triangles merged into it. The nodes of the edge polygons stay, so the groups still meet each
+    /// other and the edge meshes. Needs vertex i to be node i + 1 of the triangulation of its face, so it
+    /// has to run before optimizeVertexCache. Unused vertices are dropped. Returns false and leaves the
+    /// buffers as they are when they do not line up with the triangulations of faces.
+    bool decimate(double ratio, double maxError)
+    {
+        std::vector<Handle(Poly_Triangulation)> triangulations(faces.size());
+        std::vector<uint32_t> vertexStarts(faces.size() + 1, 0);
+        for (size_t g = 0; g < faces.size(); g++) {
+            TopLoc_Location location;
+            triangulations[g] = BRep_Tool::Triangulation(faces[g], location);
+            vertexStarts[g + 1] = vertexStarts[g] + (triangulations[g].IsNull() ? 0 : triangulations[g]->NbNodes());
+        }
+        if (vertexStarts.back() != position.size() / 3 || faces.size() * 2 != group.size()) {
+            return false;
+        }
+
+        std::vector<std::vector<uint32_t>> groupIndices(faces.size());
+        OSD_Parallel::For(0, static_cast<int>(faces.size()), [&](int g) {
+            uint32_t vertexStart = vertexStarts[g], vertexCount = vertexStarts[g + 1] - vertexStart;
+            std::vector<bool> locked(vertexCount, false);
+            for (TopExp_Explorer ex(faces[g], TopAbs_EDGE); ex.More(); ex.Next()) {
+                TopLoc_Location location;
+                auto polygon = BRep_Tool::PolygonOnTriangulation(TopoDS::Edge(ex.Current()), triangulations[g], location);
+                if (!polygon.IsNull()) {
+                    for (auto node : polygon->Nodes()) {
+                        locked[node - 1] = true;
+                    }
+                }
+            }
+
+            std::vector<uint32_t> local(index.begin() + group[g * 2], index.begin() + group[g * 2] + group[g * 2 + 1]);
+            for (auto& i : local) {
+                i -= vertexStart;
+            }
+            size_t target = static_cast<size_t>(local.size() / 3 * ratio) * 3;
+            groupIndices[g] = simplifyTriangles(position.data() + vertexStart * 3, vertexCount, local.data(), local.size(),
+                std::move(locked), target, maxError);
+        });
+
+        FaceMesher result;
+        for (size_t g = 0; g < faces.size(); g++) {
+            std::vector<uint32_t> remap(vertexStarts[g + 1] - vertexStarts[g], std::numeric_limits<uint32_t>::max());
+            result.group.push_back(result.index.size());
+            result.group.push_back(groupIndices[g].size());
+            for (auto i : groupIndices[g]) {
+                if (remap[i] == std::numeric_limits<uint32_t>::max()) {
+                    remap[i] = result.position.size() / 3;
+                    size_t v = vertexStarts[g] + i;
+                    result.position.insert(result.position.end(), position.begin() + v * 3, position.begin() + v * 3 + 3);
+                    result.normal.insert(result.normal.end(), normal.begin() + v * 3, normal.begin() + v * 3 + 3);
+                    result.uv.insert(result.uv.end(), uv.begin() + v * 2, uv.begin() + v * 2 + 2);
+                }
+                result.index.push_back(remap[i]);
+            }
+        }
+        position = std::move(result.position);
+        normal = std::move(result.normal);
+        uv = std::move(result.uv);
+        index = std::move(result.index);
+        group = std::move(result.group);
+        return true;
+    }
+
+    /// @brief Reorders the triangles of every face group for the post-transform cache, then the vertices
+    /// of the group in the order the triangles use them. The groups own their vertices, so they are
+    /// optimized concurrently. Vertex i no longer matches node i + 1 of the triangulation afterwards.
+    void optimizeVertexCache()
+    {
+        OSD_Parallel::For(0, static_cast<int>(group.size() / 2), [this](int g) {
+            uint32_t* groupIndices = index.data() + group[g * 2];
+            uint32_t count = group[g * 2 + 1];
+            if (count == 0) {
+                return;
+            }
+            auto [minIt, maxIt] = std::minmax_element(groupIndices, groupIndices + count);
+            uint32_t vertexStart = *minIt, vertexCount = *maxIt - *minIt + 1;
+            ::optimizeVertexCache(groupIndices, count, vertexStart, vertexCount);
+            auto remap = optimizeVertexFetch(groupIndices, count, vertexStart, vertexCount);
+            if (!vertices.empty()) {
+                remapVertices(vertices, vertexStride, vertexStart, remap);
+                return;
+            }
+            remapVertices(position, 3, vertexStart, remap);
+            remapVertices(normal, 3, vertexStart, remap);
+            remapVertices(uv, 2, vertexStart, remap);
+        });
+    }
+
+    static uint32_t strideOf(VertexLayout layout)
+    {
+        return layout == VertexLayout::Interleaved ? 32 : 20;
+    }
+
+    /// @brief Packs count normals and uvs of consecutive floats into the Packed vertices at vertex.
+    static void packVertices(const float* normal, const float* uv, size_t count, uint8_t* vertex)
+    {
+        for (size_t i = 0; i < count; i++, normal += 3, uv += 2, vertex += 20) {
+            auto [u, v] = octahedral(normal[0], normal[1], normal[2]);
+            int16_t packedNormal[2] = { quantizeSnorm16(u), quantizeSnorm16(v) };
+            uint16_t packedUv[2] = { quantizeUnorm16(uv[0]), quantizeUnorm16(uv[1]) };
+            std::memcpy(vertex + 12, packedNormal, 4);
+            std::memcpy(vertex + 16, packedUv, 4);
+        }
+    }
+
+    /// @brief Moves position, normal and uv into vertices, they are empty afterwards. Only needed after
+    /// decimate, meshShape fills vertices directly when layout is set.
+    void interleave(VertexLayout target)
+    {
+        if (target == VertexLayout::Separate || !vertices.empty()) {
+            return;
+        }
+
+        size_t count = position.size() / 3;
+        vertexStride = strideOf(target);
+        vertices.resize(count * vertexStride);
+        auto* floats = reinterpret_cast<float*>(vertices.data());
+        size_t floatStride = vertexStride / sizeof(float);
+        for (size_t i = 0; i < count; i++) {
+            std::copy_n(position.data() + i * 3, 3, floats + i * floatStride);
+        }
+        if (target == VertexLayout::Interleaved) {
+            for (size_t i = 0; i < count; i++) {
+                std::copy_n(normal.data() + i * 3, 3, floats + i * floatStride + 3);
+                std::copy_n(uv.data() + i * 2, 2, floats + i * floatStride + 6);
+            }
+        } else {
+            packVertices(normal.data(), uv.data(), count, vertices.data());
+        }
+        position = std::vector<float>();
+        normal = std::vector<float>();
+        uv = std::vector<float>();
+    }
+
+    /// @brief The first pass counts the nodes and triangles of every face and lays the faces out with
+    /// a prefix sum, the second one fills each face into its own slice on the OCCT thread pool.
+    void meshShape(const TopoDS_Shape& shape, std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    {
+        std::vector<FaceSlice> slices;
+        auto vertexCount = this->position.size() / 3;
+        auto indexCount = this->index.size();
+        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+        for (NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher>::Iterator anIt(faceMap); anIt.More(); anIt.Next()) {
+            auto face = TopoDS::Face(anIt.Value());
+            TopLoc_Location location;
+            auto handlePoly = BRep_Tool::Triangulation(face, location);
+            if (!handlePoly.IsNull()) {
+                slices.push_back(FaceSlice { face, handlePoly, location.Transformation(), vertexCount, indexCount });
+                this->faces.push_back(face);
+                this->group.push_back(indexCount);
+                this->group.push_back(handlePoly->NbTriangles() * 3);
+                vertexCount += handlePoly->NbNodes();
+                indexCount += handlePoly->NbTriangles() * 3;
+                facePolyMap[face] = handlePoly;
+            }
+        }
+
+        if (layout == VertexLayout::Separate) {
+            this->position.resize(vertexCount * 3);
+            this->normal.resize(vertexCount * 3);
+            this->uv.resize(vertexCount * 2);
+        } else {
+            vertexStride = strideOf(layout);
+            vertices.resize(vertexCount * vertexStride);
+        }
+        this->index.resize(indexCount);
+
+        // The normals are stored on the triangulation, which is shared by every occurrence of a face,
+        // so they are computed once per triangulation before the faces are filled concurrently.
+        std::vector<const FaceSlice*> owners;
+        std::unordered_set<const Poly_Triangulation*> seen;
+        for (const auto& slice : slices) {
+            if (!slice.handlePoly->HasNormals() && seen.insert(slice.handlePoly.get()).second) {
+                owners.push_back(&slice);
+            }
+        }
+        OSD_Parallel::For(0, static_cast<int>(owners.size()), [&owners](int i) {
+            ensureNormals(owners[i]->face, owners[i]->handlePoly);
+        });
+        OSD_Parallel::For(0, static_cast<int>(slices.size()), [this, &slices](int i) {
+            fillFace(slices[i]);
+        });
+    }
+
+    void generateFaceMesh(const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly, const gp_Trsf& trsf)
+    {
+        if (handlePoly.IsNull()) {
+            return;
+        }
+
+        auto indexStart = this->index.size();
+        auto vertexStart = appendVertices(face, handlePoly, trsf);
+        this->index.resize(indexStart + handlePoly->NbTriangles() * 3);
+        fillIndex(this->index.data() + indexStart, vertexStart, handlePoly, face.Orientation());
+
+        this->group.push_back(indexStart);
+        this->group.push_back(this->index.size() - indexStart);
+    }
+
+    /// @brief Appends the vertices of a triangulation without indices, returns the first vertex.
+    size_t appendVertices(const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly, const gp_Trsf& trsf)
+    {
+        auto vertexStart = this->position.size() / 3;
+        this->position.resize((vertexStart + handlePoly->NbNodes()) * 3);
+        this->normal.resize((vertexStart + handlePoly->NbNodes()) * 3);
+        this->uv.resize((vertexStart + handlePoly->NbNodes()) * 2);
+
+        ensureNormals(face, handlePoly);
+        fillVertices(face, handlePoly, trsf, vertexStart);
+        return vertexStart;
+    }
+
+    /// @brief Planar faces get their constant normal without evaluating the surface at every node, the
+    /// others go through ComputeNormals. The normals are in the frame of the triangulation, so the surface
+    /// is taken like ComputeNormals does: with the location it has inside the face, without the one of the face.
+    static void ensureNormals(const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly)
+    {
+        if (handlePoly->HasNormals()) {
+            return;
+        }
+
+        auto surface = BRep_Tool::Surface(TopoDS::Face(face.Located(TopLoc_Location())));
+        GeomAdaptor_Surface adaptor;
+        if (!surface.IsNull()) {
+            adaptor.Load(surface);
+        }
+        if (surface.IsNull() || adaptor.GetType() != GeomAbs_Plane) {
+            BRepLib_ToolTriangulatedShape::ComputeNormals(face, handlePoly);
+            return;
+        }
+
+        auto position = adaptor.Plane().Position();
+        auto dir = position.Direct() ? position.Direction() : position.Direction().Reversed();
+        gp_Vec3f normal(static_cast<float>(dir.X()), static_cast<float>(dir.Y()), static_cast<float>(dir.Z()));
+        handlePoly->AddNormals();
+        for (int i = 1; i <= handlePoly->NbNodes(); i++) {
+            handlePoly->SetNormal(i, normal);
+        }
+    }
+
+    /// @brief Writes the nodes stride floats apart, 3 for position or more for interleaved vertices.
+    static void fillPosition(const gp_Trsf& transform, const Handle(Poly_Triangulation) & handlePoly, float* position,
+        size_t stride = 3)
+    {
+        const auto& nodes = handlePoly->InternalNodes();
+        if (nodes.IsDoublePrecision() && handlePoly->NbNodes() > 0) {
+            transformPoints(AffineTransform(transform), nodes.First<gp_Pnt>().XYZ().GetData(), handlePoly->NbNodes(),
+                position, stride);
+            return;
+        }
+
+        for (int index = 0; index < handlePoly->NbNodes(); index++, position += stride) {
+            auto pnt = handlePoly->Node(index + 1).Transformed(transform);
+            position[0] = pnt.X();
+            position[1] = pnt.Y();
+            position[2] = pnt.Z();
+        }
+    }
+
+    /// @brief Expects the normals to be computed already.
+    static void fillNormal(const gp_Trsf& transform, const Handle(Poly_Triangulation) & handlePoly,
+        bool shouldReverse, float* normal, size_t stride = 3)
+    {
+        const auto& normals = handlePoly->InternalNormals();
+        if (normals.Length() == handlePoly->NbNodes() && handlePoly->NbNodes() > 0) {
+            transformNormals(AffineTransform(transform), normals.First().GetData(), handlePoly->NbNodes(),
+                shouldReverse, normal, stride);
+            return;
+        }
+
+        for (int index = 0; index < handlePoly->NbNodes(); index++, normal += stride) {
+            auto dir = handlePoly->Normal(index + 1);
+            if (shouldReverse) {
+                dir.Reverse();
+            }
+            dir = dir.Transformed(transform);
+            normal[0] = dir.X();
+            normal[1] = dir.Y();
+            normal[2] = dir.Z();
+        }
+    }
+
+    static void fillIndex(uint32_t* index, size_t indexStart, const Handle(Poly_Triangulation) & handlePoly,
+        const TopAbs_Orientation& orientation)
+    {
+        for (int i = 0; i < handlePoly->NbTriangles(); i++) {
+            auto v1(1), v2(2), v3(3);
+            if (orientation == TopAbs_REVERSED) {
+                v2 = 3;
+                v3 = 2;
+            }
+
+            auto triangle = handlePoly->Triangle(i + 1);
+            *index++ = triangle.Value(v1) - 1 + indexStart;
+            *index++ = triangle.Value(v2) - 1 + indexStart;
+            *index++ = triangle.Value(v3) - 1 + indexStart;
+        }
+    }
+
+    static void fillUv(const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly, float* uv,
+        size_t stride = 2)
+    {
+        double aUmin, aUmax, aVmin, aVmax, dUmax, dVmax;
+        BRepTools::UVBounds(face, aUmin, aUmax, aVmin, aVmax);
+        dUmax = (aUmax - aUmin);
+        dVmax = (aVmax - aVmin);
+        for (int index = 0; index < handlePoly->NbNodes(); index++, uv += stride) {
+            auto node = handlePoly->UVNode(index + 1);
+            uv[0] = (node.X() - aUmin) / dUmax;
+            uv[1] = (node.Y() - aVmin) / dVmax;
+        }
+    }
+
+private:
+    void fillFace(const FaceSlice& slice)
+    {
+        fillIndex(this->index.data() + slice.indexStart, slice.vertexStart, slice.handlePoly, slice.face.Orientation());
+        fillVertices(slice.face, slice.handlePoly, slice.trsf, slice.vertexStart);
+    }
+
+    /// @brief Interleaved vertices are written in place through the strides of the fill functions. Packed
+    /// ones only take the position that way, the normals and uvs of the face go through a scratch buffer
+    /// to be quantized.
+    void fillVertices(const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly, const gp_Trsf& trsf,
+        size_t vertexStart)
+    {
+        bool shouldReverse = (face.Orientation() == TopAbs_REVERSED) ^ (trsf.VectorialPart().Determinant() < 0);
+        if (layout == VertexLayout::Separate) {
+            fillPosition(trsf, handlePoly, this->position.data() + vertexStart * 3);
+            fillNormal(trsf, handlePoly, shouldReverse, this->normal.data() + vertexStart * 3);
+            fillUv(face, handlePoly, this->uv.data() + vertexStart * 2);
+            return;
+        }
+
+        uint8_t* vertex = vertices.data() + vertexStart * vertexStride;
+        auto* floats = reinterpret_cast<float*>(vertex);
+        size_t floatStride = vertexStride / sizeof(float);
+        fillPosition(trsf, handlePoly, floats, floatStride);
+        if (layout == VertexLayout::Interleaved) {
+            fillNormal(trsf, handlePoly, shouldReverse, floats + 3, floatStride);
+            fillUv(face, handlePoly, floats + 6, floatStride);
+            return;
+        }
+
+        size_t count = handlePoly->NbNodes();
+        std::vector<float> normals(count * 3), uvs(count * 2);
+        fillNormal(trsf, handlePoly, shouldReverse, normals.data());
+        fillUv(face, handlePoly, uvs.data());
+        packVertices(normals.data(), uvs.data(), count, vertex);
+    }
+};
@@ -32,6 +32,7 @@
 #include <BRepPrimAPI_MakeRevol.hxx>
 #include <BRepPrimAPI_MakeSphere.hxx>
 #include <BRepProj_Projection.hxx>
+#include <BRepTools_History.hxx>
 #include <Geom_BezierCurve.hxx>
 #include <ShapeAnalysis_Edge.hxx>
 #include <ShapeAnalysis_WireOrder.hxx>
@@ -46,11 +47,13 @@
 
 using namespace emscripten;
 
-struct ShapeResult {
-    TopoDS_Shape shape;
-    bool isOk;
-    std::string error;
-};
+template <typename TAlgo>
+Handle(BRepTools_History) makeHistory(const TopoDS_Shape& argument, TAlgo& algo)
+{
+    NCollection_List<TopoDS_Shape> arguments;
+    arguments.Append(argument);
+    return new BRepTools_History(arguments, algo);
+}
 
 class ShapeFactory {
 public:
@@ -263,7 +266,7 @@ public:
         if (!prism.IsDone()) {
             return ShapeResult { TopoDS_Shape(), false, "Failed to create prism" };
         }
-        return ShapeResult { prism.Shape(), true, "" };
+        return ShapeResult { prism.Shape(), true, "", makeHistory(sbase, prism) };
     }
 
     static ShapeResult polygon(const Vector3Array& points)
@@ -483,16 +486,17 @@ public:
         auto argsList = shapeArrayToListOfShape(args);
         auto toolsList = shapeArrayToListOfShape(tools);
 
-        boolOperater.SetToFillHistory(false);
+        boolOperater.SetToFillHistory(true);
         boolOperater.SetArguments(argsList);
         boolOperater.SetTools(toolsList);
         boolOperater.SetFuzzyValue(1e-6);
+        boolOperater.SetRunParallel(true);
         boolOperater.Build();
         if (!boolOperater.IsDone()) {
             return ShapeResult { TopoDS_Shape(), false, "Failed to build boolean operation" };
         }
 
-        return ShapeResult { boolOperater.Shape(), true, "" };
+        return ShapeResult { boolOperater.Shape(), true, "", boolOperater.History() };
     }
 
     static ShapeResult booleanCommon(const ShapeArray& args, const ShapeArray& tools)
@@ -541,7 +545,7 @@ public:
             return ShapeResult { TopoDS_Shape(), false, "Failed to fillet" };
         }
 
-        return ShapeResult { makeFillet.Shape(), true, "" };
+        return ShapeResult { makeFillet.Shape(), true, "", makeHistory(shape, makeFillet) };
     }
 
     static ShapeResult chamfer(const TopoDS_Shape& shape, const NumberArray& edges, double distance)
@@ -559,7 +563,7 @@ public:
         if (!makeChamfer.IsDone()) {
             return ShapeResult { TopoDS_Shape(), false, "Failed to chamfer" };
         }
-        return ShapeResult { makeChamfer.Shape(), true, "" };
+        return ShapeResult { makeChamfer.Shape(), true, "", makeHistory(shape, makeChamfer) };
     }
 
     static ShapeResult loft(const ShapeArray& sections, bool isSolid, bool isRuled, GeomAbs_Shape continuity)
@@ -632,7 +636,8 @@ EMSCRIPTEN_BINDINGS(ShapeFactory)
     class_<ShapeResult>("ShapeResult")
         .property("shape", &ShapeResult::shape, return_value_policy::reference())
         .property("isOk", &ShapeResult::isOk)
-        .property("error", &ShapeResult::error);
+        .property("error", &ShapeResult::error)
+        .property("history", &ShapeResult::history);
 
     class_<ShapeFactory>("ShapeFactory")
         .class_function("box", &ShapeFactory::box)
@@ -5,28 +5,58 @@
 #include <emscripten/val.h>
 
 #include <BRepAdaptor_Curve.hxx>
+#include <BRepAdaptor_Surface.hxx>
 #include <BRepBndLib.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepBuilderAPI_MakeVertex.hxx>
+#include <BRepGProp.hxx>
 #include <BRepLib_ToolTriangulatedShape.hxx>
 #include <BRepMesh_IncrementalMesh.hxx>
 #include <BRepTools.hxx>
+#include <BRepTools_History.hxx>
+#include <BRep_Builder.hxx>
 #include <BRep_Tool.hxx>
+#include <Bnd_Box.hxx>
+#include <GCPnts_AbscissaPoint.hxx>
 #include <GCPnts_TangentialDeflection.hxx>
+#include <GProp_GProps.hxx>
+#include <GeomAdaptor_Surface.hxx>
+#include <IMeshTools_Parameters.hxx>
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressRange.hxx>
+#include <NCollection_Map.hxx>
+#include <OSD_Parallel.hxx>
 #include <Poly_Triangulation.hxx>
+#include <Precision.hxx>
 #include <Standard_Handle.hxx>
 #include <TopExp.hxx>
 #include <TopExp_Explorer.hxx>
 #include <TopLoc_Location.hxx>
 #include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
 #include <TopoDS_Edge.hxx>
 #include <TopoDS_Face.hxx>
+#include <TopoDS_Iterator.hxx>
 #include <TopoDS_Shape.hxx>
+#include <TopoDS_TShape.hxx>
 #include <UnitsMethods.hxx>
 #include <gp_Dir.hxx>
 #include <gp_Pnt.hxx>
 #include <gp_Vec.hxx>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <list>
+#include <unordered_set>
 
+#include "bvh.hpp"
+#include "decimate.hpp"
+#include "face_mesher.hpp"
 #include "shared.hpp"
+#include "transform.hpp"
 #include "utils.hpp"
+#include "vertex_cache.hpp"
 
 using namespace emscripten;
 using namespace std;
@@ -48,269 +78,2405 @@ void addPointToPosition(const gp_Pnt& pnt, std::optional<gp_Pnt>& prePnt, std::v
     prePnt = pnt;
 }
 
-void pointByGCTangential(const TopoDS_Edge& edge, double lineDeflection, std::vector<float>& position)
+class EdgeMesher {
+public:
+    double lineDeflection;
+    /// @brief Writes every polyline point once and the segments to index, otherwise position holds
+    /// a pair of points per segment.
+    bool isIndexed = false;
+    std::vector<float> position;
+    std::vector<uint32_t> index;
+    /// @brief start1,count1,start2,count2... counted in index when indexed, in position otherwise
+    std::vector<uint32_t> group;
+    std::vector<TopoDS_Edge> edges;
+
+    EdgeMesher(double lineDeflection)
+        : lineDeflection(lineDeflection)
+    {
+    }
+
+    void generateEdgeMesh(const TopoDS_Edge& edge, const Handle(Poly_Triangulation) & triangulation)
+    {
+        auto start = this->groupSize();
+
+        if (triangulation.IsNull()) {
+            pointByGCTangential(edge);
+        } else {
+            TopLoc_Location location;
+            Handle(Poly_PolygonOnTriangulation) polygon = BRep_Tool::PolygonOnTriangulation(edge, triangulation, location);
+            if (polygon.IsNull()) {
+                pointByGCTangential(edge);
+            } else {
+                auto trsf = location.Transformation();
+                pointByFaceTriangulation(polygon, triangulation, trsf);
+            }
+        }
+
+        this->group.push_back(start);
+        this->group.push_back(this->groupSize() - start);
+    }
+
+    void meshShape(const TopoDS_Shape& shape, std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    {
+        NCollection_IndexedDataMap<TopoDS_Shape, NCollection_List<TopoDS_Shape>, TopTools_ShapeMapHasher> mapEF;
+        TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, mapEF);
+        for (int ie = 1; ie <= mapEF.Extent(); ie++) {
+            meshEdge(TopoDS::Edge(mapEF.FindKey(ie)), mapEF(ie), facePolyMap);
+        }
+    }
+
+    /// @brief Appends one edge, using the triangulation of the first of its faces that has one.
+    void meshEdge(const TopoDS_Edge& edge, const NCollection_List<TopoDS_Shape>& faces,
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    {
+        this->edges.push_back(edge);
+        this->generateEdgeMesh(edge, faceTriangulation(faces, facePolyMap));
+    }
+
+    void pointByFaceTriangulation(const Handle(Poly_PolygonOnTriangulation) & polygon,
+        const Handle(Poly_Triangulation) & triangulation, const gp_Trsf& transform)
+    {
+        std::optional<gp_Pnt> prePnt = std::nullopt;
+        auto nodeIndex = polygon->Nodes();
+        for (auto i = nodeIndex.Lower(); i <= nodeIndex.Upper(); i++) {
+            auto pnt = triangulation->Node(nodeIndex[i]).Transformed(transform);
+            addPoint(pnt, prePnt);
+        }
+    }
+
+private:
+    /// @brief The first triangulation among the faces of an edge. Faces missing from facePolyMap are
+    /// looked up on the shape, so an empty map reuses whatever BRepMesh left there.
+    static Handle(Poly_Triangulation) faceTriangulation(const NCollection_List<TopoDS_Shape>& faces,
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    {
+        for (const auto& shape : faces) {
+            const TopoDS_Face& face = TopoDS::Face(shape);
+            auto it = facePolyMap.find(face);
+            if (it != facePolyMap.end()) {
+                return it->second;
+            }
+            TopLoc_Location location;
+            auto triangulation = BRep_Tool::Triangulation(face, location);
+            if (!triangulation.IsNull()) {
+                return triangulation;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t groupSize() const
+    {
+        return isIndexed ? this->index.size() : this->position.size() / 3;
+    }
+
+    void pointByGCTangential(const TopoDS_Edge& edge)
+    {
+        BRepAdaptor_Curve curve(edge);
+        GCPnts_TangentialDeflection pnts(curve, ANGLE_DEFLECTION, this->lineDeflection);
+
+        std::optional<gp_Pnt> prePnt = std::nullopt;
+        for (int i = 0; i < pnts.NbPoints(); i++) {
+            addPoint(pnts.Value(i + 1), prePnt);
+        }
+    }
+
+    void addPoint(const gp_Pnt& pnt, std::optional<gp_Pnt>& prePnt)
+    {
+        if (!isIndexed) {
+            addPointToPosition(pnt, prePnt, this->position);
+            return;
+        }
+
+        uint32_t count = this->position.size() / 3;
+        if (prePnt.has_value()) {
+            this->index.push_back(count - 1);
+            this->index.push_back(count);
+        }
+        this->position.push_back(pnt.X());
+        this->position.push_back(pnt.Y());
+        this->position.push_back(pnt.Z());
+        prePnt = pnt;
+    }
+};
+
+template <typename TArray, typename TMesher, typename T>
+TArray meshBufferView(const std::weak_ptr<TMesher>& mesher, std::vector<T> TMesher::*buffer)
+{
+    static const std::vector<T> empty;
+    auto owner = mesher.lock();
+    return typedArrayView<TArray>(owner ? (*owner).*buffer : empty);
+}
+
+template <typename TArray, typename TMesher, typename T>
+TArray groupIndexView(const std::weak_ptr<TMesher>& mesher, std::vector<T> GroupIndex::*buffer)
+{
+    static const std::vector<T> empty;
+    auto owner = mesher.lock();
+    return typedArrayView<TArray>(owner ? owner->groupIndex.*buffer : empty);
+}
+
+/// @brief The buffers are views over memory owned by the Mesher. They are created on access,
+/// become empty after Mesher::release, and must be copied before calling back into wasm.
+struct EdgeMeshData {
+    std::weak_ptr<EdgeMesher> mesher;
+    EdgeArray edges;
+
+    Float32Array position() const
+    {
+        return meshBufferView<Float32Array>(mesher, &EdgeMesher::position);
+    }
+
+    /// @brief Only filled when Mesher.indexedEdges is set.
+    Uint32Array index() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &EdgeMesher::index);
+    }
+
+    /// @brief start1,count1,start2,count2...
+    Uint32Array group() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &EdgeMesher::group);
+    }
+};
+
+/// @brief The buffers are views over memory owned by the Mesher. They are created on access,
+/// become empty after Mesher::release, and must be copied before calling back into wasm.
+struct FaceMeshData {
+    std::weak_ptr<FaceMesher> mesher;
+    FaceArray faces;
+
+    Float32Array position() const
+    {
+        return meshBufferView<Float32Array>(mesher, &FaceMesher::position);
+    }
+
+    Float32Array normal() const
+    {
+        return meshBufferView<Float32Array>(mesher, &FaceMesher::normal);
+    }
+
+    Float32Array uv() const
+    {
+        return meshBufferView<Float32Array>(mesher, &FaceMesher::uv);
+    }
+
+    Uint32Array index() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &FaceMesher::index);
+    }
+
+    /// @brief start1,count1,start2,count2...
+    Uint32Array group() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &FaceMesher::group);
+    }
+
+    /// @brief Only filled when Mesher.compactIndex is set, index is empty then.
+    Uint16Array index16() const
+    {
+        return groupIndexView<Uint16Array>(mesher, &GroupIndex::index16);
+    }
+
+    Uint32Array index32() const
+    {
+        return groupIndexView<Uint32Array>(mesher, &GroupIndex::index32);
+    }
+
+    /// @brief baseVertex,vertexCount,indexStart,indexCount...
+    Uint32Array indexGroup() const
+    {
+        return groupIndexView<Uint32Array>(mesher, &GroupIndex::indexGroup);
+    }
+
+    /// @brief Only filled when Mesher.vertexLayout is not Separate, position, normal and uv are empty then.
+    Uint8Array vertices() const
+    {
+        return meshBufferView<Uint8Array>(mesher, &FaceMesher::vertices);
+    }
+
+    uint32_t vertexStride() const
+    {
+        auto owner = mesher.lock();
+        return owner ? owner->vertexStride : 0;
+    }
+};
+
+struct MeshData {
+    EdgeMeshData edgeMeshData;
+    FaceMeshData faceMeshData;
+};
+
+/// @brief Compact vertex layout of 12 bytes instead of 32: positions as unorm16 within the bounding box
+/// of their face group, octahedral normals as two snorm8 and uvs as unorm16. Each face is meshed into
+/// a scratch FaceMesher and quantized right away, so the float buffers never exist for the whole shape.
+class QuantizedFaceMesher {
+    FaceMesher scratch;
+
+    void quantizeFace()
+    {
+        auto vertexStart = this->position.size() / 3;
+        auto vertexCount = scratch.position.size() / 3;
+
+        float min[3] = { 0, 0, 0 };
+        float max[3] = { 0, 0, 0 };
+        for (size_t i = 0; i < vertexCount; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                auto value = scratch.position[i * 3 + axis];
+                min[axis] = i == 0 ? value : std::min(min[axis], value);
+                max[axis] = i == 0 ? value : std::max(max[axis], value);
+            }
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            this->positionOffset.push_back(min[axis]);
+            this->positionScale.push_back((max[axis] - min[axis]) / 65535);
+        }
+
+        for (size_t i = 0; i < vertexCount; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                auto extent = max[axis] - min[axis];
+                auto value = scratch.position[i * 3 + axis];
+                this->position.push_back(quantizeUnorm16(extent > 0 ? (value - min[axis]) / extent : 0));
+            }
+            appendOctahedral(scratch.normal[i * 3], scratch.normal[i * 3 + 1], scratch.normal[i * 3 + 2], this->normal);
+            this->uv.push_back(quantizeUnorm16(scratch.uv[i * 2]));
+            this->uv.push_back(quantizeUnorm16(scratch.uv[i * 2 + 1]));
+        }
+
+        auto groupStart = this->index.size();
+        for (auto index : scratch.index) {
+            this->index.push_back(index + vertexStart);
+        }
+        this->group.push_back(groupStart);
+        this->group.push_back(this->index.size() - groupStart);
+    }
+
+public:
+    std::vector<uint16_t> position;
+    std::vector<int8_t> normal;
+    std::vector<uint16_t> uv;
+    std::vector<uint32_t> index;
+    /// @brief start1,count1,start2,count2...
+    std::vector<uint32_t> group;
+    /// @brief x,y,z per group
+    std::vector<float> positionOffset;
+    /// @brief x,y,z per group
+    std::vector<float> positionScale;
+    std::vector<TopoDS_Face> faces;
+    GroupIndex groupIndex;
+
+    /// @brief Moves the indices into groupIndex, index is empty afterwards.
+    void compactIndex()
+    {
+        groupIndex.build(index, group);
+        index = std::vector<uint32_t>();
+    }
+
+    void meshShape(const TopoDS_Shape& shape, std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    {
+        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+        for (NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher>::Iterator anIt(faceMap); anIt.More(); anIt.Next()) {
+            auto face = TopoDS::Face(anIt.Value());
+            TopLoc_Location location;
+            auto handlePoly = BRep_Tool::Triangulation(face, location);
+            if (!handlePoly.IsNull()) {
+                scratch = FaceMesher();
+                scratch.generateFaceMesh(face, handlePoly, location.Transformation());
+                quantizeFace();
+                this->faces.push_back(face);
+                facePolyMap[face] = handlePoly;
+            }
+        }
+        scratch = FaceMesher();
+    }
+};
+
+/// @brief position = positionOffset + positionScale * position for the group of the vertex, normals
+/// decode from the octahedron after dividing by 127 and uvs are divided by 65535. The buffers are
+/// views like the ones of FaceMeshData.
+struct QuantizedFaceMeshData {
+    std::weak_ptr<QuantizedFaceMesher> mesher;
+    FaceArray faces;
+
+    Uint16Array position() const
+    {
+        return meshBufferView<Uint16Array>(mesher, &QuantizedFaceMesher::position);
+    }
+
+    Int8Array normal() const
+    {
+        return meshBufferView<Int8Array>(mesher, &QuantizedFaceMesher::normal);
+    }
+
+    Uint16Array uv() const
+    {
+        return meshBufferView<Uint16Array>(mesher, &QuantizedFaceMesher::uv);
+    }
+
+    Uint32Array index() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &QuantizedFaceMesher::index);
+    }
+
+    /// @brief start1,count1,start2,count2...
+    Uint32Array group() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &QuantizedFaceMesher::group);
+    }
+
+    Float32Array positionOffset() const
+    {
+        return meshBufferView<Float32Array>(mesher, &QuantizedFaceMesher::positionOffset);
+    }
+
+    Float32Array positionScale() const
+    {
+        return meshBufferView<Float32Array>(mesher, &QuantizedFaceMesher::positionScale);
+    }
+
+    /// @brief Only filled when Mesher.compactIndex is set, index is empty then.
+    Uint16Array index16() const
+    {
+        return groupIndexView<Uint16Array>(mesher, &GroupIndex::index16);
+    }
+
+    Uint32Array index32() const
+    {
+        return groupIndexView<Uint32Array>(mesher, &GroupIndex::index32);
+    }
+
+    /// @brief baseVertex,vertexCount,indexStart,indexCount...
+    Uint32Array indexGroup() const
+    {
+        return groupIndexView<Uint32Array>(mesher, &GroupIndex::indexGroup);
+    }
+};
+
+struct QuantizedMeshData {
+    EdgeMeshData edgeMeshData;
+    QuantizedFaceMeshData faceMeshData;
+};
+
+/// @brief Appends a column-major 4x4 matrix, the layout expected by Matrix4.fromArray.
+void appendMatrix(const gp_Trsf& trsf, std::vector<float>& matrix)
+{
+    for (int col = 1; col <= 4; col++) {
+        for (int row = 1; row <= 3; row++) {
+            matrix.push_back(trsf.Value(row, col));
+        }
+        matrix.push_back(col == 4 ? 1 : 0);
+    }
+}
+
+/// @brief Meshes every distinct TShape of an assembly once, in its local space,
+/// and records a (mesh id, transform) pair for each of its occurrences.
+class InstanceMesher {
+    std::unordered_map<TopoDS_Shape, uint32_t> meshIds;
+
+public:
+    FaceMesher faceMesher;
+    EdgeMesher edgeMesher;
+    /// @brief faceStart,faceCount,edgeStart,edgeCount per mesh, counted in face and edge groups
+    std::vector<uint32_t> meshes;
+    std::vector<uint32_t> instanceMesh;
+    /// @brief a column-major 4x4 matrix per instance
+    std::vector<float> instanceMatrix;
+    std::vector<TopoDS_Shape> prototypes;
+
+    InstanceMesher(double lineDeflection)
+        : edgeMesher(lineDeflection)
+    {
+    }
+
+    void meshShape(const TopoDS_Shape& shape)
+    {
+        if (shape.ShapeType() == TopAbs_COMPOUND) {
+            for (TopoDS_Iterator iter(shape); iter.More(); iter.Next()) {
+                meshShape(iter.Value());
+            }
+            return;
+        }
+
+        auto prototype = shape.Located(TopLoc_Location());
+        auto it = meshIds.find(prototype);
+        auto meshId = it != meshIds.end() ? it->second : addPrototype(prototype);
+        instanceMesh.push_back(meshId);
+        appendMatrix(shape.Location().Transformation(), instanceMatrix);
+    }
+
+private:
+    uint32_t addPrototype(const TopoDS_Shape& prototype)
+    {
+        auto faceStart = faceMesher.faces.size();
+        auto edgeStart = edgeMesher.edges.size();
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+        faceMesher.meshShape(prototype, facePolyMap);
+        edgeMesher.meshShape(prototype, facePolyMap);
+
+        meshes.push_back(faceStart);
+        meshes.push_back(faceMesher.faces.size() - faceStart);
+        meshes.push_back(edgeStart);
+        meshes.push_back(edgeMesher.edges.size() - edgeStart);
+
+        uint32_t meshId = prototypes.size();
+        prototypes.push_back(prototype);
+        meshIds[prototype] = meshId;
+        return meshId;
+    }
+};
+
+/// @brief Face and edge groups are in the local space of the prototypes; each instance
+/// places one prototype with its matrix.
+struct InstancedMeshData {
+    std::weak_ptr<InstanceMesher> mesher;
+    EdgeMeshData edgeMeshData;
+    FaceMeshData faceMeshData;
+    ShapeArray prototypes;
+
+    /// @brief faceStart,faceCount,edgeStart,edgeCount per prototype
+    Uint32Array meshes() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &InstanceMesher::meshes);
+    }
+
+    Uint32Array instanceMesh() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &InstanceMesher::instanceMesh);
+    }
+
+    /// @brief a column-major 4x4 matrix per instance
+    Float32Array instanceMatrix() const
+    {
+        return meshBufferView<Float32Array>(mesher, &InstanceMesher::instanceMatrix);
+    }
+};
+
+/// @brief Packs several triangulations of every face, coarse to fine, into one vertex buffer with an
+/// index buffer and face groups per level. A face whose triangulation does not change between two
+/// levels, like most planar faces, shares its vertices with the previous level.
+class LodMesher {
+    static bool isSameTriangulation(const Handle(Poly_Triangulation) & a, const Handle(Poly_Triangulation) & b)
+    {
+        if (a->NbNodes() != b->NbNodes() || a->NbTriangles() != b->NbTriangles()) {
+            return false;
+        }
+        for (int i = 1; i <= a->NbNodes(); i++) {
+            if (!a->Node(i).IsEqual(b->Node(i), Precision::Confusion())) {
+                return false;
+            }
+        }
+        for (int i = 1; i <= a->NbTriangles(); i++) {
+            auto ta = a->Triangle(i);
+            auto tb = b->Triangle(i);
+            if (ta(1) != tb(1) || ta(2) != tb(2) || ta(3) != tb(3)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    /// @brief position, normal and uv of all levels; index and group stay empty
+    FaceMesher faceMesher;
+    std::vector<double> deflections;
+    std::vector<std::vector<uint32_t>> index;
+    /// @brief start1,count1,start2,count2... per level
+    std::vector<std::vector<uint32_t>> group;
+
+    void meshShape(const TopoDS_Shape& shape, std::vector<double> levels)
+    {
+        std::sort(levels.begin(), levels.end(), std::greater<double>());
+        deflections = levels;
+        index.resize(levels.size());
+        group.resize(levels.size());
+
+        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+
+        // Every run of BRepMesh replaces the triangulation of the faces, so the levels are meshed on a
+        // copy that shares the geometry and the triangulation of the shape itself is left alone.
+        BRepBuilderAPI_Copy copier(shape, false, false);
+        std::vector<std::vector<Handle(Poly_Triangulation)>> triangulations(levels.size());
+        std::vector<gp_Trsf> transforms(faceMap.Extent());
+        for (size_t level = 0; level < levels.size(); level++) {
+            BRepMesh_IncrementalMesh mesh(copier.Shape(), levels[level], true, ANGLE_DEFLECTION, true);
+            for (int i = 1; i <= faceMap.Extent(); i++) {
+                TopLoc_Location location;
+                auto copy = TopoDS::Face(copier.ModifiedShape(faceMap(i)));
+                triangulations[level].push_back(BRep_Tool::Triangulation(copy, location));
+                transforms[i - 1] = location.Transformation();
+            }
+        }
+
+        for (int i = 1; i <= faceMap.Extent(); i++) {
+            auto face = TopoDS::Face(faceMap(i));
+            faceMesher.faces.push_back(face);
+            meshFace(face, transforms[i - 1], triangulations, i - 1);
+        }
+    }
+
+private:
+    void meshFace(const TopoDS_Face& face, const gp_Trsf& trsf,
+        const std::vector<std::vector<Handle(Poly_Triangulation)>>& triangulations, size_t faceIndex)
+    {
+        Handle(Poly_Triangulation) previous;
+        size_t vertexStart = 0;
+        for (size_t level = 0; level < triangulations.size(); level++) {
+            const auto& handlePoly = triangulations[level][faceIndex];
+            auto groupStart = index[level].size();
+            if (!handlePoly.IsNull()) {
+                if (previous.IsNull() || !isSameTriangulation(previous, handlePoly)) {
+                    vertexStart = faceMesher.appendVertices(face, handlePoly, trsf);
+                    previous = handlePoly;
+                }
+                index[level].resize(groupStart + handlePoly->NbTriangles() * 3);
+                FaceMesher::fillIndex(index[level].data() + groupStart, vertexStart, handlePoly, face.Orientation());
+            }
+            group[level].push_back(groupStart);
+            group[level].push_back(index[level].size() - groupStart);
+        }
+    }
+};
+
+/// @brief Levels are ordered coarse to fine and index into the shared vertex buffer. Every level has a
+/// group per face, empty when the face has no triangulation at that level.
+struct LodMeshData {
+    std::weak_ptr<LodMesher> mesher;
+    std::weak_ptr<FaceMesher> vertices;
+    FaceArray faces;
+    NumberArray deflections;
+
+    Float32Array position() const
+    {
+        return meshBufferView<Float32Array>(vertices, &FaceMesher::position);
+    }
+
+    Float32Array normal() const
+    {
+        return meshBufferView<Float32Array>(vertices, &FaceMesher::normal);
+    }
+
+    Float32Array uv() const
+    {
+        return meshBufferView<Float32Array>(vertices, &FaceMesher::uv);
+    }
+
+    Uint32Array index(size_t level) const
+    {
+        return levelView(&LodMesher::index, level);
+    }
+
+    /// @brief start1,count1,start2,count2...
+    Uint32Array group(size_t level) const
+    {
+        return levelView(&LodMesher::group, level);
+    }
+
+private:
+    Uint32Array levelView(std::vector<std::vector<uint32_t>> LodMesher::*buffer, size_t level) const
+    {
+        static const std::vector<uint32_t> empty;
+        auto owner = mesher.lock();
+        if (!owner || level >= ((*owner).*buffer).size()) {
+            return typedArrayView<Uint32Array>(empty);
+        }
+        return typedArrayView<Uint32Array>(((*owner).*buffer)[level]);
+    }
+};
+
+struct MeshCacheKey {
+    TopoDS_Shape shape;
+    double meshDeflection;
+    double lineDeflection;
+
+    bool operator==(const MeshCacheKey& other) const
+    {
+        return shape.IsEqual(other.shape) && meshDeflection == other.meshDeflection
+            && lineDeflection == other.lineDeflection;
+    }
+};
+
+struct MeshCacheKeyHasher {
+    size_t operator()(const MeshCacheKey& key) const
+    {
+        size_t hash = std::hash<TopoDS_Shape>()(key.shape);
+        hash = hash * 31 + key.shape.Orientation();
+        hash = hash * 31 + std::hash<double>()(key.meshDeflection);
+        return hash * 31 + std::hash<double>()(key.lineDeflection);
+    }
+};
+
+struct MeshCacheEntry {
+    MeshCacheKey key;
+    std::shared_ptr<FaceMesher> faceMesher;
+    std::shared_ptr<EdgeMesher> edgeMesher;
+    size_t bytes;
+};
+
+/// @brief LRU cache of packed mesh buffers keyed by shape identity and deflection.
+/// It is disabled until a capacity is set, so Mesher.release keeps freeing the buffers by default.
+/// Entries of shapes deleted everywhere else go on the next insert or size, see dropReleased.
+class MeshCache {
+    std::list<MeshCacheEntry> entries;
+    std::unordered_map<MeshCacheKey, std::list<MeshCacheEntry>::iterator, MeshCacheKeyHasher> index;
+    size_t capacity = 0;
+    size_t bytes = 0;
+    size_t hitCount = 0;
+    size_t missCount = 0;
+
+    static size_t bufferBytes(const FaceMesher& faceMesher, const EdgeMesher& edgeMesher)
+    {
+        return (faceMesher.position.capacity() + faceMesher.normal.capacity() + faceMesher.uv.capacity()
+                   + edgeMesher.position.capacity())
+            * sizeof(float)
+            + (faceMesher.index.capacity() + faceMesher.group.capacity() + edgeMesher.group.capacity())
+            * sizeof(uint32_t)
+            + faceMesher.faces.capacity() * sizeof(TopoDS_Face) + edgeMesher.edges.capacity() * sizeof(TopoDS_Edge);
+    }
+
+    /// @brief References to the TShape of an entry held by the entry itself: the key, and the face or edge
+    /// list when the shape is a single face or edge.
+    static long ownReferences(const MeshCacheEntry& entry)
+    {
+        const auto& shape = entry.key.shape;
+        long references = 1;
+        if (shape.ShapeType() == TopAbs_FACE && entry.faceMesher) {
+            for (const auto& face : entry.faceMesher->faces) {
+                references += face.TShape() == shape.TShape();
+            }
+        } else if (shape.ShapeType() == TopAbs_EDGE && entry.edgeMesher) {
+            for (const auto& edge : entry.edgeMesher->edges) {
+                references += edge.TShape() == shape.TShape();
+            }
+        }
+        return references;
+    }
+
+    /// @brief The keys keep the B-rep and its triangulations alive, which the capacity does not count.
+    /// Entries of shapes that nothing outside the cache refers to any more can never hit again, so they
+    /// are dropped before they hold that memory until eviction.
+    void dropReleased()
+    {
+        std::unordered_map<const TopoDS_TShape*, long> references;
+        for (const auto& entry : entries) {
+            if (!entry.key.shape.IsNull()) {
+                references[entry.key.shape.TShape().get()] += ownReferences(entry);
+            }
+        }
+        for (auto it = entries.begin(); it != entries.end();) {
+            const auto& tshape = it->key.shape.TShape();
+            if (!tshape.IsNull() && tshape->GetRefCount() <= references[tshape.get()]) {
+                bytes -= it->bytes;
+                index.erase(it->key);
+                it = entries.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+
+    void evict()
+    {
+        while (bytes > capacity && !entries.empty()) {
+            auto& last = entries.back();
+            bytes -= last.bytes;
+            index.erase(last.key);
+            entries.pop_back();
+        }
+    }
+
+public:
+    static MeshCache& instance()
+    {
+        static MeshCache cache;
+        return cache;
+    }
+
+    /// @brief Whether key has an entry, without counting a hit or miss or touching the LRU order.
+    bool contains(const MeshCacheKey& key) const
+    {
+        return capacity != 0 && index.find(key) != index.end();
+    }
+
+    /// @brief The entry of key, counted as a hit or miss. No scan for released shapes is needed here: the key
+    /// holds its shape, so a stale entry can never match it.
+    std::optional<MeshCacheEntry> find(const MeshCacheKey& key)
+    {
+        if (capacity == 0) {
+            return std::nullopt;
+        }
+        auto it = index.find(key);
+        if (it == index.end()) {
+            missCount++;
+            return std::nullopt;
+        }
+        hitCount++;
+        entries.splice(entries.begin(), entries, it->second);
+        return *it->second;
+    }
+
+    void insert(const MeshCacheKey& key, const std::shared_ptr<FaceMesher>& faceMesher,
+        const std::shared_ptr<EdgeMesher>& edgeMesher)
+    {
+        auto size = bufferBytes(*faceMesher, *edgeMesher);
+        if (size > capacity || index.find(key) != index.end()) {
+            return;
+        }
+        dropReleased();
+        entries.push_front(MeshCacheEntry { key, faceMesher, edgeMesher, size });
+        index[key] = entries.begin();
+        bytes += size;
+        evict();
+    }
+
+    static size_t hits()
+    {
+        return instance().hitCount;
+    }
+
+    static size_t misses()
+    {
+        return instance().missCount;
+    }
+
+    static size_t size()
+    {
+        instance().dropReleased();
+        return instance().bytes;
+    }
+
+    static void setCapacity(size_t capacity)
+    {
+        instance().capacity = capacity;
+        instance().evict();
+    }
+
+    static void clear()
+    {
+        auto& cache = instance();
+        cache.entries.clear();
+        cache.index.clear();
+        cache.bytes = 0;
+        cache.hitCount = 0;
+        cache.missCount = 0;
+    }
+};
+
+using FaceAncestors
+    = NCollection_IndexedDataMap<TopoDS_Shape, NCollection_List<TopoDS_Shape>, TopTools_ShapeMapHasher>;
+
+/// @brief The relative mode scales the deflection of an edge with the size of the meshed shape. Two vertices
+/// at the corners of box make a compound of a few faces as large as the shape they come from, so the faces
+/// get the deflection a mesh of the whole shape gives them.
+void addBoxCorners(const BRep_Builder& builder, TopoDS_Compound& compound, const Bnd_Box& box)
+{
+    if (!box.IsVoid()) {
+        builder.Add(compound, BRepBuilderAPI_MakeVertex(box.CornerMin()).Vertex());
+        builder.Add(compound, BRepBuilderAPI_MakeVertex(box.CornerMax()).Vertex());
+    }
+}
+
+/// @brief Length of the chords BRepMesh uses on a curvature radius: the sagitta stays below the deflection
+/// and the angle between neighbouring chords below ANGLE_DEFLECTION.
+double chordLength(double radius, double deflection)
+{
+    double sagittaChord = 2 * std::sqrt(std::max(2 * radius * deflection - deflection * deflection, 0.0));
+    return std::max(std::min(sagittaChord, radius * ANGLE_DEFLECTION), Precision::Confusion());
+}
+
+/// @brief Triangle count of a face as a function of the absolute deflection. Planar faces only pay for
+/// their curved boundaries, singly curved faces for a strip around the axis and all others for a grid
+/// of chords over their area. It is a rough guess meant to rank deflections, not to predict BRepMesh.
+class TriangleEstimate {
+    GeomAbs_SurfaceType type;
+    double area = 0;
+    double radius = 0;
+    double span = 0;
+    double straightEdges = 0;
+    std::vector<std::pair<double, double>> curvedEdges;
+    double curvature = std::numeric_limits<double>::infinity();
+
+public:
+    explicit TriangleEstimate(const TopoDS_Face& face)
+    {
+        BRepAdaptor_Surface surface(face, false);
+        type = surface.GetType();
+        GProp_GProps props;
+        BRepGProp::SurfaceProperties(face, props);
+        area = std::abs(props.Mass());
+
+        double uMin, uMax, vMin, vMax;
+        BRepTools::UVBounds(face, uMin, uMax, vMin, vMax);
+        switch (type) {
+        case GeomAbs_Plane:
+            for (TopExp_Explorer ex(face, TopAbs_EDGE); ex.More(); ex.Next()) {
+                BRepAdaptor_Curve curve(TopoDS::Edge(ex.Current()));
+                if (curve.GetType() == GeomAbs_Line) {
+                    straightEdges += 1;
+                    continue;
+                }
+                double length = GCPnts_AbscissaPoint::Length(curve);
+                double curveRadius = curve.GetType() == GeomAbs_Circle ? curve.Circle().Radius() : length;
+                curvedEdges.emplace_back(curveRadius, length);
+                curvature = std::min(curvature, curveRadius);
+            }
+            break;
+        case GeomAbs_Cylinder:
+        case GeomAbs_Cone:
+            span = uMax - uMin;
+            radius = area / std::max(span * (vMax - vMin), Precision::Confusion());
+            curvature = radius;
+            break;
+        case GeomAbs_Sphere:
+            radius = surface.Sphere().Radius();
+            curvature = radius;
+            break;
+        case GeomAbs_Torus:
+            radius = surface.Torus().MinorRadius();
+            curvature = radius;
+            break;
+        default:
+            radius = std::sqrt(area);
+            break;
+        }
+    }
+
+    /// @brief Smallest radius of curvature of the face or of its curved boundaries, infinite when the
+    /// surface type gives none.
+    double curvatureRadius() const
+    {
+        return curvature;
+    }
+
+    double count(double deflection) const
+    {
+        double triangles = 0;
+        switch (type) {
+        case GeomAbs_Plane:
+            triangles = straightEdges;
+            for (const auto& [curveRadius, length] : curvedEdges) {
+                triangles += length / chordLength(curveRadius, deflection);
+            }
+            break;
+        case GeomAbs_Cylinder:
+        case GeomAbs_Cone:
+            triangles = 2 * span * radius / chordLength(radius, deflection);
+            break;
+        default:
+            triangles = 2 * area / std::pow(chordLength(radius, deflection), 2);
+            break;
+        }
+        return std::max(triangles, 2.0);
+    }
+};
+
+/// @brief A face meshed with a deflection of its own. Its size is the smaller of its bounding box and the
+/// diameter of its tightest curvature, so a small hole in a large part keeps its detail.
+struct BudgetFace {
+    TopoDS_Face face;
+    TriangleEstimate triangles;
+    double size;
+    double deflection = 0;
+    double estimated = 0;
+
+    explicit BudgetFace(const TopoDS_Face& face)
+        : face(face)
+        , triangles(face)
+        , size(std::min(boundingBoxRatio(face, 1, false), 2 * triangles.curvatureRadius()))
+    {
+    }
+
+    double estimate(double ratio) const
+    {
+        return triangles.count(ratio * size);
+    }
+};
+
+std::vector<BudgetFace> budgetFaces(const TopoDS_Shape& shape)
+{
+    std::vector<BudgetFace> faces;
+    NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+    TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+    for (int i = 1; i <= faceMap.Extent(); i++) {
+        faces.emplace_back(TopoDS::Face(faceMap(i)));
+    }
+    return faces;
+}
+
+/// @brief Picks the finest deflection ratio, not finer than minRatio, whose estimate fits the budget,
+/// sets the deflection of every face from it and returns the estimated triangles. When even a ratio of
+/// one does not fit, that ratio is used and the estimate returned is above the budget.
+double fitBudget(std::vector<BudgetFace>& faces, double minRatio, double budget)
+{
+    auto estimate = [&faces](double ratio) {
+        double triangles = 0;
+        for (const auto& face : faces) {
+            triangles += face.estimate(ratio);
+        }
+        return triangles;
+    };
+
+    double low = std::log(std::max(minRatio, 1e-6));
+    double high = std::log(1.0);
+    if (estimate(std::exp(low)) > budget) {
+        for (int i = 0; i < 30; i++) {
+            double middle = (low + high) / 2;
+            if (estimate(std::exp(middle)) > budget) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        low = high;
+    }
+
+    double ratio = std::exp(low);
+    double triangles = 0;
+    for (auto& face : faces) {
+        face.deflection = ratio * face.size;
+        face.estimated = face.estimate(ratio);
+        triangles += face.estimated;
+    }
+    return triangles;
+}
+
+/// @brief Meshes the faces finest first, in groups whose deflections lie within a factor of two so that
+/// BRepMesh still runs on many faces at once. The faces of earlier groups go along with their neighbours:
+/// BRepMesh keeps their finer triangulation and reuses the polygons of the shared edges, so the seams
+/// between faces of different deflections stay closed. The triangulations of an earlier mesh are dropped
+/// first, as BRepMesh would keep those too.
+void triangulateBudgetFaces(std::vector<BudgetFace>& faces)
+{
+    BRep_Builder builder;
+    TopoDS_Compound all;
+    builder.MakeCompound(all);
+    for (const auto& face : faces) {
+        BRepTools::Clean(face.face);
+        builder.Add(all, face.face);
+    }
+    FaceAncestors mapEF;
+    TopExp::MapShapesAndAncestors(all, TopAbs_EDGE, TopAbs_FACE, mapEF);
+
+    std::sort(faces.begin(), faces.end(),
+        [](const BudgetFace& a, const BudgetFace& b) { return a.deflection < b.deflection; });
+    NCollection_Map<TopoDS_Shape, TopTools_ShapeMapHasher> meshed;
+    for (size_t first = 0; first < faces.size();) {
+        double deflection = faces[first].deflection;
+        size_t last = first;
+        while (last < faces.size() && faces[last].deflection <= 2 * deflection) {
+            last++;
+        }
+
+        TopoDS_Compound group;
+        builder.MakeCompound(group);
+        NCollection_Map<TopoDS_Shape, TopTools_ShapeMapHasher> added;
+        for (size_t i = first; i < last; i++) {
+            builder.Add(group, faces[i].face);
+            for (TopExp_Explorer ex(faces[i].face, TopAbs_EDGE); ex.More(); ex.Next()) {
+                for (const auto& neighbour : mapEF.FindFromKey(ex.Current())) {
+                    if (meshed.Contains(neighbour) && added.Add(neighbour)) {
+                        builder.Add(group, neighbour);
+                    }
+                }
+            }
+        }
+        BRepMesh_IncrementalMesh mesh(group, deflection, false, ANGLE_DEFLECTION, true);
+        for (size_t i = first; i < last; i++) {
+            meshed.Add(faces[i].face);
+        }
+        first = last;
+    }
+}
+
+class Mesher {
+    TopoDS_Shape shape;
+    double meshDeflection;
+    double lineDeflection;
+    bool isTriangulated = false;
+    bool isCompactIndex = false;
+    bool isIndexedEdges = false;
+    VertexLayout vertexLayout = VertexLayout::Separate;
+    bool isOptimizedVertexCache = false;
+    bool isLocalSpace = false;
+    bool isDecimated = false;
+    bool useBoxRatio = false;
+    double triangleBudget = 0;
+    int changedFaceCount = 0;
+    std::shared_ptr<FaceMesher> faceMesher;
+    std::shared_ptr<EdgeMesher> edgeMesher;
+    std::shared_ptr<InstanceMesher> instanceMesher;
+    std::shared_ptr<LodMesher> lodMesher;
+    std::shared_ptr<QuantizedFaceMesher> quantizedMesher;
+    std::vector<float> edgePosition;
+    std::vector<float> location;
+
+    void triangulate()
+    {
+        if (isTriangulated) {
+            return;
+        }
+        BRepMesh_IncrementalMesh mesh(shape, meshDeflection, true, ANGLE_DEFLECTION, true);
+        isTriangulated = true;
+    }
+
+    /// @brief Runs BRepMesh only on the faces the operation created or modified, together with their
+    /// untouched neighbours so that the polygons of the shared edges are reused and the seams stay closed.
+    /// Faces the history leaves alone are the source faces themselves and keep their triangulation.
+    void triangulateChanged(const TopoDS_Shape& source, const Handle(BRepTools_History) & history)
+    {
+        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+        NCollection_Map<TopoDS_Shape, TopTools_ShapeMapHasher> untouched;
+        for (TopExp_Explorer ex(source, TopAbs_FACE); ex.More(); ex.Next()) {
+            TopLoc_Location location;
+            const TopoDS_Shape& face = ex.Current();
+            if (faceMap.Contains(face) && !history->IsRemoved(face) && history->Modified(face).IsEmpty()
+                && !BRep_Tool::Triangulation(TopoDS::Face(face), location).IsNull()) {
+                untouched.Add(face);
+            }
+        }
+
+        NCollection_IndexedDataMap<TopoDS_Shape, NCollection_List<TopoDS_Shape>, TopTools_ShapeMapHasher> mapEF;
+        TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, mapEF);
+        NCollection_Map<TopoDS_Shape, TopTools_ShapeMapHasher> added;
+        TopoDS_Compound changed;
+        BRep_Builder builder;
+        builder.MakeCompound(changed);
+        for (int i = 1; i <= faceMap.Extent(); i++) {
+            const TopoDS_Shape& face = faceMap(i);
+            if (untouched.Contains(face)) {
+                continue;
+            }
+            if (added.Add(face)) {
+                builder.Add(changed, face);
+            }
+            for (TopExp_Explorer ex(face, TopAbs_EDGE); ex.More(); ex.Next()) {
+                for (const auto& neighbour : mapEF.FindFromKey(ex.Current())) {
+                    if (added.Add(neighbour)) {
+                        builder.Add(changed, neighbour);
+                    }
+                }
+            }
+        }
+
+        changedFaceCount = faceMap.Extent() - untouched.Extent();
+        isTriangulated = true;
+        if (added.IsEmpty()) {
+            return;
+        }
+
+        // Sized like the source, the neighbours ask for the deflection they already have and keep their
+        // triangulation.
+        Bnd_Box sourceBox;
+        BRepBndLib::Add(source, sourceBox, false);
+        addBoxCorners(builder, changed, sourceBox);
+        BRepMesh_IncrementalMesh mesh(changed, meshDeflection, true, ANGLE_DEFLECTION, true);
+    }
+
+    /// @brief The MeshCache only holds the default layout with the default deflection.
+    bool usesCache() const
+    {
+        return !isCompactIndex && !isIndexedEdges && vertexLayout == VertexLayout::Separate && !isOptimizedVertexCache
+            && triangleBudget == 0;
+    }
+
+    /// @brief A local mesh of a shape is the mesh of the shape without its location, so all placements
+    /// of one shape share a cache entry.
+    MeshCacheKey cacheKey() const
+    {
+        return MeshCacheKey { meshedShape(), meshDeflection, lineDeflection };
+    }
+
+    TopoDS_Shape meshedShape() const
+    {
+        return isLocalSpace ? shape.Located(TopLoc_Location()) : shape;
+    }
+
+    /// @brief Faces or edges taken from meshedShape, moved back to where they are in shape so that they stay
+    /// IsSame with its sub-shapes. Only the positions and normals leave the location out.
+    template <typename TArray, typename T>
+    TArray placed(const std::vector<T>& subShapes) const
+    {
+        if (!isLocalSpace || shape.Location().IsIdentity()) {
+            return TArray(val::array(subShapes));
+        }
+        std::vector<T> result(subShapes);
+        for (auto& subShape : result) {
+            subShape.Move(shape.Location());
+        }
+        return TArray(val::array(result));
+    }
+
+    /// @brief Applies the output options to faceMesher, in the order they depend on each other. The vertices
+    /// are only interleaved here when decimate needed them separate.
+    void finishFaces()
+    {
+        if (isOptimizedVertexCache) {
+            faceMesher->optimizeVertexCache();
+        }
+        if (isCompactIndex) {
+            faceMesher->compactIndex();
+        }
+        faceMesher->interleave(vertexLayout);
+    }
+
+    /// @brief The box is taken from meshedShape, so that rotating a shape meshed in local space keeps the
+    /// deflection and with it the cache entry.
+    void initLineDeflection(bool useBoxRatio)
+    {
+        this->useBoxRatio = useBoxRatio;
+        if (useBoxRatio) {
+            this->lineDeflection = boundingBoxRatio(meshedShape(), meshDeflection, false);
+        } else {
+            this->lineDeflection = meshDeflection;
+        }
+    }
+
+public:
+    Mesher(const TopoDS_Shape& shape, double lineDeflection, bool useBoxRatio)
+        : shape(shape)
+        , meshDeflection(lineDeflection)
+    {
+        initLineDeflection(useBoxRatio);
+        if (!MeshCache::instance().contains(cacheKey())) {
+            triangulate();
+        }
+    }
+
+    /// @brief Meshes the result of a modeling operation incrementally. Untouched faces keep the triangulation
+    /// they have in the source, so the source should have been meshed with the same deflection.
+    Mesher(const TopoDS_Shape& shape, double lineDeflection, bool useBoxRatio, const TopoDS_Shape& source,
+        const Handle(BRepTools_History) & history)
+        : shape(shape)
+        , meshDeflection(lineDeflection)
+    {
+        initLineDeflection(useBoxRatio);
+        if (MeshCache::instance().contains(cacheKey())) {
+            return;
+        }
+        if (history.IsNull()) {
+            triangulate();
+        } else {
+            triangulateChanged(source, history);
+        }
+    }
+
+    /// @brief Meshes each face with a deflection relative to its own size and curvature. The ratio is the
+    /// finest one, from lineDeflection up, whose estimated triangle count fits triangleBudget. The
+    /// triangulations of an earlier mesh of the shape are replaced.
+    Mesher(const TopoDS_Shape& shape, double lineDeflection, bool useBoxRatio, double triangleBudget)
+        : shape(shape)
+        , meshDeflection(lineDeflection)
+        , triangleBudget(triangleBudget)
+    {
+        initLineDeflection(useBoxRatio);
+        auto faces = budgetFaces(shape);
+        fitBudget(faces, meshDeflection, triangleBudget);
+        triangulateBudgetFaces(faces);
+        isTriangulated = true;
+    }
+
+    bool getCompactIndex() const
+    {
+        return isCompactIndex;
+    }
+
+    /// @brief Makes mesh and meshQuantized emit index16/index32/indexGroup instead of index.
+    void setCompactIndex(bool value)
+    {
+        isCompactIndex = value;
+    }
+
+    bool getIndexedEdges() const
+    {
+        return isIndexedEdges;
+    }
+
+    /// @brief Makes the edge meshes write each polyline point once and index the segments.
+    void setIndexedEdges(bool value)
+    {
+        isIndexedEdges = value;
+    }
+
+    bool getOptimizeVertexCache() const
+    {
+        return isOptimizedVertexCache;
+    }
+
+    /// @brief Makes mesh reorder the triangles and vertices of each face group with FaceMesher::optimizeVertexCache.
+    void setOptimizeVertexCache(bool value)
+    {
+        isOptimizedVertexCache = value;
+    }
+
+    /// @brief False when the last meshDecimated could not simplify and returned the full mesh.
+    bool getDecimated() const
+    {
+        return isDecimated;
+    }
+
+    /// @brief Faces the constructor for a modeling operation triangulated because the history created or
+    /// modified them, the others kept the triangulation of the source. 0 for the other constructors.
+    int getChangedFaces() const
+    {
+        return changedFaceCount;
+    }
+
+    bool getLocalSpace() const
+    {
+        return isLocalSpace;
+    }
+
+    /// @brief Makes mesh, meshDecimated, meshQuantized, meshLevels and edgesMeshPosition leave the location
+    /// of the shape out of the positions and normals, locationMatrix places them. Moving the shape then only
+    /// changes the matrix, and the cache serves the new placement. The faces and edges stay those of the
+    /// placed shape. meshInstanced ignores it, its instance matrices already hold the placements.
+    void setLocalSpace(bool value)
+    {
+        if (value != isLocalSpace) {
+            isLocalSpace = value;
+            initLineDeflection(useBoxRatio);
+        }
+    }
+
+    /// @brief The location of the shape as a column-major 4x4 matrix.
+    Float32Array locationMatrix()
+    {
+        location = std::vector<float>();
+        appendMatrix(shape.Location().Transformation(), location);
+        return typedArrayView<Float32Array>(location);
+    }
+
+    VertexLayout getVertexLayout() const
+    {
+        return vertexLayout;
+    }
+
+    /// @brief Makes mesh write the vertices into FaceMeshData.vertices with the given layout.
+    void setVertexLayout(VertexLayout value)
+    {
+        vertexLayout = value;
+    }
+
+    /// @brief Segment pairs of all edges, taken from the polygons BRepMesh left on the faces. Only free
+    /// edges and edges without a polygon are discretized with GCPnts_TangentialDeflection.
+    Float32Array edgesMeshPosition()
+    {
+        EdgeMesher mesher(lineDeflection);
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+        mesher.meshShape(meshedShape(), facePolyMap);
+        edgePosition = std::move(mesher.position);
+
+        return typedArrayView<Float32Array>(edgePosition);
+    }
+
+    /// @brief Serves the buffers from the MeshCache when it holds them. Only this lookup counts as a hit or
+    /// miss, the other mesh functions bypass the cache.
+    MeshData mesh()
+    {
+        if (usesCache()) {
+            auto cached = MeshCache::instance().find(cacheKey());
+            if (cached.has_value()) {
+                faceMesher = cached->faceMesher;
+                edgeMesher = cached->edgeMesher;
+                return MeshData { EdgeMeshData { edgeMesher, placed<EdgeArray>(edgeMesher->edges) },
+                    FaceMeshData { faceMesher, placed<FaceArray>(faceMesher->faces) } };
+            }
+        }
+
+        triangulate();
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+        auto faceMeshData = meshFaces(facePolyMap, vertexLayout);
+        auto edgeMeshData = meshEdges(facePolyMap);
+        finishFaces();
+        if (usesCache()) {
+            MeshCache::instance().insert(cacheKey(), faceMesher, edgeMesher);
+        }
+
+        return MeshData { edgeMeshData, faceMeshData };
+    }
+
+    /// @brief Same as mesh with the faces simplified by FaceMesher::decimate, for distant levels of detail.
+    /// ratio is the share of triangles to keep, maxError in model units stops earlier, 0 for no limit; it
+    /// bounds the root mean square distance of a moved vertex to the surface it replaces.
+    MeshData meshDecimated(double ratio, double maxError)
+    {
+        triangulate();
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+        auto faceMeshData = meshFaces(facePolyMap, VertexLayout::Separate);
+        auto edgeMeshData = meshEdges(facePolyMap);
+        isDecimated = faceMesher->decimate(ratio, maxError);
+        finishFaces();
+        return MeshData { edgeMeshData, faceMeshData };
+    }
+
+    InstancedMeshData meshInstanced()
+    {
+        triangulate();
+        instanceMesher = std::make_shared<InstanceMesher>(lineDeflection);
+        instanceMesher->meshShape(shape);
+
+        std::shared_ptr<FaceMesher> faces(instanceMesher, &instanceMesher->faceMesher);
+        std::shared_ptr<EdgeMesher> edges(instanceMesher, &instanceMesher->edgeMesher);
+        return InstancedMeshData { instanceMesher, EdgeMeshData { edges, EdgeArray(val::array(edges->edges)) },
+            FaceMeshData { faces, FaceArray(val::array(faces->faces)) },
+            ShapeArray(val::array(instanceMesher->prototypes)) };
+    }
+
+    /// @brief Same faces and edges as mesh, with the compact vertex layout of QuantizedFaceMesher.
+    QuantizedMeshData meshQuantized()
+    {
+        triangulate();
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+        quantizedMesher = std::make_shared<QuantizedFaceMesher>();
+        quantizedMesher->meshShape(meshedShape(), facePolyMap);
+        auto edgeMeshData = meshEdges(facePolyMap);
+        if (isCompactIndex) {
+            quantizedMesher->compactIndex();
+        }
+
+        return QuantizedMeshData { edgeMeshData,
+            QuantizedFaceMeshData { quantizedMesher, placed<FaceArray>(quantizedMesher->faces) } };
+    }
+
+    /// @brief Triangulates the faces once per deflection, each relative like the one of the constructor.
+    /// The viewer can switch between the levels without calling back into wasm.
+    LodMeshData meshLevels(const NumberArray& deflections)
+    {
+        lodMesher = std::make_shared<LodMesher>();
+        lodMesher->meshShape(meshedShape(), vecFromJSArray<double>(deflections));
+
+        std::shared_ptr<FaceMesher> vertices(lodMesher, &lodMesher->faceMesher);
+        return LodMeshData { lodMesher, vertices, placed<FaceArray>(vertices->faces),
+            NumberArray(val::array(lodMesher->deflections)) };
+    }
+
+    /// @brief Frees the buffers behind the views returned by the mesh functions and edgesMeshPosition.
+    /// Buffers that are also held by the MeshCache stay alive until they are evicted.
+    void release()
+    {
+        faceMesher.reset();
+        edgeMesher.reset();
+        instanceMesher.reset();
+        lodMesher.reset();
+        quantizedMesher.reset();
+        edgePosition = std::vector<float>();
+        location = std::vector<float>();
+    }
+
+    EdgeMeshData meshEdges(std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    {
+        edgeMesher = std::make_shared<EdgeMesher>(lineDeflection);
+        edgeMesher->isIndexed = isIndexedEdges;
+        edgeMesher->meshShape(meshedShape(), facePolyMap);
+        return EdgeMeshData { edgeMesher, placed<EdgeArray>(edgeMesher->edges) };
+    }
+
+    FaceMeshData meshFaces(std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap,
+        VertexLayout layout)
+    {
+        faceMesher = std::make_shared<FaceMesher>();
+        faceMesher->layout = layout;
+        faceMesher->meshShape(meshedShape(), facePolyMap);
+        return FaceMeshData { faceMesher, placed<FaceArray>(faceMesher->faces) };
+    }
+};
+
+/// @brief Edges of many shapes in one EdgeMeshData, for wireframe views of large assemblies. The shapes
+/// are not triangulated: edges reuse the polygons of faces that were meshed before and fall back to
+/// GCPnts_TangentialDeflection otherwise.
+class EdgeBatchMesher {
+    std::shared_ptr<EdgeMesher> edgeMesher;
+    std::vector<uint32_t> shapeGroup;
+
+public:
+    EdgeBatchMesher(const ShapeArray& shapes, double lineDeflection, bool useBoxRatio)
+        : edgeMesher(std::make_shared<EdgeMesher>(lineDeflection))
+    {
+        for (const auto& shape : vecFromJSArray<TopoDS_Shape>(shapes)) {
+            if (useBoxRatio) {
+                edgeMesher->lineDeflection = boundingBoxRatio(shape, lineDeflection, false);
+            }
+            auto edgeStart = edgeMesher->edges.size();
+            std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+            edgeMesher->meshShape(shape, facePolyMap);
+            shapeGroup.push_back(edgeStart);
+            shapeGroup.push_back(edgeMesher->edges.size() - edgeStart);
+        }
+    }
+
+    EdgeMeshData mesh() const
+    {
+        if (!edgeMesher) {
+            return EdgeMeshData { edgeMesher, EdgeArray(val::array()) };
+        }
+        return EdgeMeshData { edgeMesher, EdgeArray(val::array(edgeMesher->edges)) };
+    }
+
+    /// @brief edgeStart,edgeCount per shape, counted in edge groups
+    Uint32Array shapes() const
+    {
+        return typedArrayView<Uint32Array>(shapeGroup);
+    }
+
+    void release()
+    {
+        edgeMesher.reset();
+        shapeGroup = std::vector<uint32_t>();
+    }
+};
+
+/// @brief Runs BRepMesh in relative mode on the faces first..last of the map, with the deflection a mesh of
+/// the whole shape in shapeBox gives them. The neighbours meshed by earlier batches go along: they keep
+/// their triangulation and lend its edge polygons to the new faces, so the batches join without cracks.
+/// The faces of a batch only get their triangulation if the run is not interrupted through the range.
+void triangulateFaces(const NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher>& faceMap,
+    const FaceAncestors& mapEF, const Bnd_Box& shapeBox, int first, int last, double deflection,
+    const Message_ProgressRange& range = Message_ProgressRange())
 {
-    BRepAdaptor_Curve curve(edge);
-    GCPnts_TangentialDeflection pnts(curve, ANGLE_DEFLECTION, lineDeflection);
+    BRep_Builder builder;
+    TopoDS_Compound batch;
+    builder.MakeCompound(batch);
+    NCollection_Map<TopoDS_Shape, TopTools_ShapeMapHasher> neighbours;
+    for (int i = first; i <= last; i++) {
+        builder.Add(batch, faceMap(i));
+        for (TopExp_Explorer ex(faceMap(i), TopAbs_EDGE); ex.More(); ex.Next()) {
+            for (const auto& neighbour : mapEF.FindFromKey(ex.Current())) {
+                if (faceMap.FindIndex(neighbour) < first && neighbours.Add(neighbour)) {
+                    builder.Add(batch, neighbour);
+                }
+            }
+        }
+    }
+    addBoxCorners(builder, batch, shapeBox);
+
+    IMeshTools_Parameters parameters;
+    parameters.Deflection = deflection;
+    parameters.Angle = ANGLE_DEFLECTION;
+    parameters.Relative = true;
+    parameters.InParallel = true;
+    BRepMesh_IncrementalMesh mesh(batch, parameters, range);
+}
+
+/// @brief Triangulates and extracts a shape a few faces at a time, so the viewer can show the first chunks
+/// while the rest is still being meshed and stop early. A chunk holds whole faces, about chunkTriangles
+/// triangles, and the edges of its faces that no earlier chunk had; free edges come with the last one.
+/// The views of a chunk become empty when the next one is requested or the stream is released.
+class MeshStream {
+    TopoDS_Shape shape;
+    double meshDeflection;
+    double lineDeflection;
+    size_t chunkTriangles;
+    Bnd_Box shapeBox;
+    NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+    FaceAncestors mapEF;
+    NCollection_Map<TopoDS_Shape, TopTools_ShapeMapHasher> sentEdges;
+    int nextFace = 1;
+    size_t triangleCount = 0;
+    bool isFinished = false;
+    std::shared_ptr<FaceMesher> faceMesher;
+    std::shared_ptr<EdgeMesher> edgeMesher;
+
+    /// @brief Meshes the next faces until the chunk is full. The number of faces handed to BRepMesh at once
+    /// is estimated from the triangles per face so far, so the faces of a chunk are still meshed in parallel.
+    TopoDS_Compound triangulateChunk()
+    {
+        BRep_Builder builder;
+        TopoDS_Compound chunk;
+        builder.MakeCompound(chunk);
+        size_t triangles = 0;
+        while (nextFace <= faceMap.Extent() && triangles < chunkTriangles) {
+            size_t perFace = nextFace > 1 ? std::max<size_t>(1, (triangleCount + triangles) / (nextFace - 1)) : chunkTriangles;
+            int count = static_cast<int>(std::max<size_t>(1, (chunkTriangles - triangles) / perFace));
+            int last = std::min(nextFace + count - 1, faceMap.Extent());
+
+            triangulateFaces(faceMap, mapEF, shapeBox, nextFace, last, meshDeflection);
+            for (int i = nextFace; i <= last; i++) {
+                TopLoc_Location location;
+                auto triangulation = BRep_Tool::Triangulation(TopoDS::Face(faceMap(i)), location);
+                triangles += triangulation.IsNull() ? 0 : triangulation->NbTriangles();
+                builder.Add(chunk, faceMap(i));
+            }
+            nextFace = last + 1;
+        }
+        triangleCount += triangles;
+        return chunk;
+    }
+
+public:
+    MeshStream(const TopoDS_Shape& shape, double lineDeflection, bool useBoxRatio, size_t chunkTriangles)
+        : shape(shape)
+        , meshDeflection(lineDeflection)
+        , lineDeflection(useBoxRatio ? boundingBoxRatio(shape, lineDeflection, false) : lineDeflection)
+        , chunkTriangles(std::max<size_t>(1, chunkTriangles))
+    {
+        BRepBndLib::Add(shape, shapeBox, false);
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+        TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, mapEF);
+    }
+
+    /// @brief The next chunk, or undefined once the whole shape has been sent.
+    std::optional<MeshData> next()
+    {
+        if (isFinished) {
+            return std::nullopt;
+        }
+
+        auto chunk = triangulateChunk();
+        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+        faceMesher = std::make_shared<FaceMesher>();
+        faceMesher->meshShape(chunk, facePolyMap);
+
+        edgeMesher = std::make_shared<EdgeMesher>(lineDeflection);
+        for (TopExp_Explorer ex(chunk, TopAbs_EDGE); ex.More(); ex.Next()) {
+            if (sentEdges.Add(ex.Current())) {
+                edgeMesher->meshEdge(TopoDS::Edge(ex.Current()), mapEF.FindFromKey(ex.Current()), facePolyMap);
+            }
+        }
+        if (nextFace > faceMap.Extent()) {
+            for (int ie = 1; ie <= mapEF.Extent(); ie++) {
+                if (sentEdges.Add(mapEF.FindKey(ie))) {
+                    edgeMesher->meshEdge(TopoDS::Edge(mapEF.FindKey(ie)), mapEF(ie), facePolyMap);
+                }
+            }
+            isFinished = true;
+        }
 
-    std::optional<gp_Pnt> prePnt = std::nullopt;
-    for (int i = 0; i < pnts.NbPoints(); i++) {
-        addPointToPosition(pnts.Value(i + 1), prePnt, position);
+        return MeshData { EdgeMeshData { edgeMesher, EdgeArray(val::array(edgeMesher->edges)) },
+            FaceMeshData { faceMesher, FaceArray(val::array(faceMesher->faces)) } };
     }
-}
 
-struct EdgeMeshData {
-    NumberArray position;
-    /// @brief start1,count1,start2,count2...
-    NumberArray group;
-    EdgeArray edges;
-};
+    int faceCount() const
+    {
+        return faceMap.Extent();
+    }
 
-struct FaceMeshData {
-    NumberArray position;
-    NumberArray normal;
-    NumberArray uv;
-    NumberArray index;
-    /// @brief start1,count1,start2,count2...
-    NumberArray group;
-    FaceArray faces;
-};
+    /// @brief Faces sent so far, for progress reporting.
+    int sentFaces() const
+    {
+        return nextFace - 1;
+    }
 
-struct MeshData {
-    EdgeMeshData edgeMeshData;
-    FaceMeshData faceMeshData;
+    void release()
+    {
+        faceMesher.reset();
+        edgeMesher.reset();
+    }
 };
 
-class EdgeMesher {
+/// @brief Breaks BRepMesh once the time slice of a MeshJob step is used up. UserBreak is called from the
+/// worker threads of a parallel run, hence the atomic flag.
+class DeadlineProgress : public Message_ProgressIndicator {
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> isExpired = false;
+
 public:
-    double lineDeflection;
-    std::vector<float> position;
-    /// @brief start1,count1,start2,count2...
-    std::vector<size_t> group;
-    std::vector<TopoDS_Edge> edges;
+    DeadlineProgress(std::chrono::steady_clock::time_point deadline)
+        : deadline(deadline)
+    {
+    }
 
-    EdgeMesher(double lineDeflection)
-        : lineDeflection(lineDeflection)
+    Standard_Boolean UserBreak() override
     {
+        if (!isExpired && std::chrono::steady_clock::now() > deadline) {
+            isExpired = true;
+        }
+        return isExpired;
     }
 
-    void generateEdgeMesh(const TopoDS_Edge& edge, const Handle(Poly_Triangulation) & triangulation)
+    void Show(const Message_ProgressScope&, const Standard_Boolean) override { }
+
+    bool expired() const
     {
-        auto start = this->position.size() / 3;
+        return isExpired;
+    }
+};
 
-        if (triangulation.IsNull()) {
-            pointByGCTangential(edge, this->lineDeflection, this->position);
-        } else {
-            TopLoc_Location location;
-            Handle(Poly_PolygonOnTriangulation) polygon = BRep_Tool::PolygonOnTriangulation(edge, triangulation, location);
-            if (polygon.IsNull()) {
-                pointByGCTangential(edge, this->lineDeflection, this->position);
-            } else {
-                auto trsf = location.Transformation();
-                pointByFaceTriangulation(polygon, triangulation, trsf);
+/// @brief Triangulates a shape in steps that each return after about budget milliseconds, so it can run on
+/// the UI thread between frames and be dropped when it is no longer needed. A step meshes batches of faces,
+/// sized from the time the previous ones took. A batch that overruns the deadline is interrupted through
+/// its Message_ProgressRange and retried smaller in the next step; a single face always runs to the end.
+class MeshJob {
+    TopoDS_Shape shape;
+    double meshDeflection;
+    double lineDeflection;
+    Bnd_Box shapeBox;
+    NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+    FaceAncestors mapEF;
+    int nextFace = 1;
+    int batchSize = 1;
+    bool isCancelled = false;
+    std::shared_ptr<FaceMesher> faceMesher;
+    std::shared_ptr<EdgeMesher> edgeMesher;
+
+public:
+    MeshJob(const TopoDS_Shape& shape, double lineDeflection, bool useBoxRatio)
+        : shape(shape)
+        , meshDeflection(lineDeflection)
+        , lineDeflection(useBoxRatio ? boundingBoxRatio(shape, lineDeflection, false) : lineDeflection)
+    {
+        BRepBndLib::Add(shape, shapeBox, false);
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+        TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, mapEF);
+    }
+
+    /// @brief Meshes faces for about budget milliseconds, returns true once every face is triangulated
+    /// or the job was cancelled.
+    bool step(double budget)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::duration<double, std::milli>(budget);
+        while (!finished() && std::chrono::steady_clock::now() < deadline) {
+            int last = std::min(nextFace + batchSize - 1, faceMap.Extent());
+            auto batchDeadline = last > nextFace ? deadline : std::chrono::steady_clock::time_point::max();
+            Handle(DeadlineProgress) progress = new DeadlineProgress(batchDeadline);
+            auto batchStart = std::chrono::steady_clock::now();
+            triangulateFaces(faceMap, mapEF, shapeBox, nextFace, last, meshDeflection, progress->Start());
+            if (progress->expired()) {
+                batchSize = std::max(1, batchSize / 2);
+                break;
             }
+
+            auto now = std::chrono::steady_clock::now();
+            double perFace = std::chrono::duration<double, std::milli>(now - batchStart).count() / (last - nextFace + 1);
+            double remaining = std::chrono::duration<double, std::milli>(deadline - now).count();
+            batchSize = std::max(1, static_cast<int>(remaining / std::max(perFace, 1e-3)));
+            nextFace = last + 1;
         }
+        return finished();
+    }
 
-        this->group.push_back(start);
-        this->group.push_back(this->position.size() / 3 - start);
+    bool finished() const
+    {
+        return isCancelled || nextFace > faceMap.Extent();
     }
 
-    void pointByFaceTriangulation(const Handle(Poly_PolygonOnTriangulation) & polygon,
-        const Handle(Poly_Triangulation) & triangulation, const gp_Trsf& transform)
+    /// @brief Triangulated faces over all faces, between 0 and 1.
+    double progress() const
     {
-        std::optional<gp_Pnt> prePnt = std::nullopt;
-        auto nodeIndex = polygon->Nodes();
-        for (auto i = nodeIndex.Lower(); i <= nodeIndex.Upper(); i++) {
-            auto pnt = triangulation->Node(nodeIndex[i]).Transformed(transform);
-            addPointToPosition(pnt, prePnt, this->position);
+        return faceMap.IsEmpty() ? 1 : static_cast<double>(nextFace - 1) / faceMap.Extent();
+    }
+
+    /// @brief Stops the job, later steps return right away and mesh returns empty data.
+    void cancel()
+    {
+        isCancelled = true;
+        release();
+    }
+
+    bool cancelled() const
+    {
+        return isCancelled;
+    }
+
+    /// @brief Extracts the faces and edges in one go, expected after the last step.
+    MeshData mesh()
+    {
+        faceMesher = std::make_shared<FaceMesher>();
+        edgeMesher = std::make_shared<EdgeMesher>(lineDeflection);
+        if (!isCancelled) {
+            std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+            faceMesher->meshShape(shape, facePolyMap);
+            edgeMesher->meshShape(shape, facePolyMap);
         }
+        return MeshData { EdgeMeshData { edgeMesher, EdgeArray(val::array(edgeMesher->edges)) },
+            FaceMeshData { faceMesher, FaceArray(val::array(faceMesher->faces)) } };
+    }
+
+    void release()
+    {
+        faceMesher.reset();
+        edgeMesher.reset();
     }
 };
 
-class FaceMesher {
-public:
-    std::vector<float> position;
-    std::vector<float> normal;
-    std::vector<float> uv;
-    std::vector<size_t> index;
-    /// @brief start1,count1,start2,count2...
-    std::vector<size_t> group;
-    std::vector<TopoDS_Face> faces;
+/// @brief Meshes an assembly under one triangle budget. Every face of every shape is meshed with the same
+/// ratio of its own size, chosen from the estimate like the budget constructor of Mesher does, and the
+/// estimated and actual triangle counts are reported per shape so the estimate can be checked.
+class SceneMesher {
+    std::vector<TopoDS_Shape> shapes;
+    double lineDeflection;
+    bool useBoxRatio;
+    std::vector<double> estimated;
+    std::vector<double> actual;
+    bool isBudgetMet;
+    std::vector<std::shared_ptr<FaceMesher>> faceMeshers;
+    std::vector<std::shared_ptr<EdgeMesher>> edgeMeshers;
 
-    void generateFaceMesh(const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly, const gp_Trsf& trsf)
+    static double triangleCount(const TopoDS_Shape& shape)
     {
-        if (handlePoly.IsNull()) {
-            return;
+        double triangles = 0;
+        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+        for (int i = 1; i <= faceMap.Extent(); i++) {
+            TopLoc_Location location;
+            auto triangulation = BRep_Tool::Triangulation(TopoDS::Face(faceMap(i)), location);
+            triangles += triangulation.IsNull() ? 0 : triangulation->NbTriangles();
         }
+        return triangles;
+    }
 
-        bool isMirrod = trsf.VectorialPart().Determinant() < 0;
-        auto orientation = face.Orientation();
-        auto groupStart = this->index.size();
-        auto indexStart = this->position.size() / 3;
+public:
+    SceneMesher(const ShapeArray& shapes, double lineDeflection, bool useBoxRatio, double triangleBudget)
+        : shapes(vecFromJSArray<TopoDS_Shape>(shapes))
+        , lineDeflection(lineDeflection)
+        , useBoxRatio(useBoxRatio)
+        , estimated(this->shapes.size())
+        , actual(this->shapes.size())
+        , faceMeshers(this->shapes.size())
+        , edgeMeshers(this->shapes.size())
+    {
+        std::vector<BudgetFace> faces;
+        std::vector<size_t> faceEnds;
+        for (const auto& shape : this->shapes) {
+            auto shapeFaces = budgetFaces(shape);
+            std::move(shapeFaces.begin(), shapeFaces.end(), std::back_inserter(faces));
+            faceEnds.push_back(faces.size());
+        }
+        isBudgetMet = fitBudget(faces, lineDeflection, triangleBudget) <= triangleBudget;
+        for (size_t i = 0, face = 0; i < faceEnds.size(); i++) {
+            for (; face < faceEnds[i]; face++) {
+                estimated[i] += faces[face].estimated;
+            }
+        }
 
-        this->fillIndex(indexStart, handlePoly, orientation);
-        this->fillPosition(trsf, handlePoly);
-        this->fillNormal(trsf, face, handlePoly, (orientation == TopAbs_REVERSED) ^ isMirrod);
-        this->fillUv(face, handlePoly);
+        triangulateBudgetFaces(faces);
+        for (size_t i = 0; i < this->shapes.size(); i++) {
+            actual[i] = triangleCount(this->shapes[i]);
+        }
+    }
 
-        this->group.push_back(groupStart);
-        this->group.push_back(this->index.size() - groupStart);
+    /// @brief The triangle budget a number of bytes buys in the layout of Mesher.mesh: 12 bytes of index
+    /// per triangle and about one 32 byte vertex per two triangles.
+    static double trianglesForBytes(double bytes)
+    {
+        return bytes / (12 + 32 / 2);
     }
 
-    void fillPosition(const gp_Trsf& transform, const Handle(Poly_Triangulation) & handlePoly)
+    /// @brief Meshes one of the shapes, the views stay valid until release. Empty for an index out of range.
+    MeshData mesh(size_t index)
     {
-        for (int index = 0; index < handlePoly->NbNodes(); index++) {
-            auto pnt = handlePoly->Node(index + 1).Transformed(transform);
-            this->position.push_back(pnt.X());
-            this->position.push_back(pnt.Y());
-            this->position.push_back(pnt.Z());
+        if (index >= shapes.size()) {
+            return MeshData { EdgeMeshData { {}, EdgeArray(val::array()) },
+                FaceMeshData { {}, FaceArray(val::array()) } };
         }
+        if (!faceMeshers[index]) {
+            double deflection = useBoxRatio ? boundingBoxRatio(shapes[index], lineDeflection, false) : lineDeflection;
+            std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+            faceMeshers[index] = std::make_shared<FaceMesher>();
+            faceMeshers[index]->meshShape(shapes[index], facePolyMap);
+            edgeMeshers[index] = std::make_shared<EdgeMesher>(deflection);
+            edgeMeshers[index]->meshShape(shapes[index], facePolyMap);
+        }
+        return MeshData { EdgeMeshData { edgeMeshers[index], EdgeArray(val::array(edgeMeshers[index]->edges)) },
+            FaceMeshData { faceMeshers[index], FaceArray(val::array(faceMeshers[index]->faces)) } };
     }
 
-    void fillNormal(const gp_Trsf& transform, const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly,
-        bool shouldReverse)
+    /// @brief Estimated triangles per shape.
+    NumberArray estimatedTriangles() const
     {
-        BRepLib_ToolTriangulatedShape::ComputeNormals(face, handlePoly);
-        for (int index = 0; index < handlePoly->NbNodes(); index++) {
-            auto normal = handlePoly->Normal(index + 1);
-            if (shouldReverse) {
-                normal.Reverse();
-            }
-            normal = normal.Transformed(transform);
-            this->normal.push_back(normal.X());
-            this->normal.push_back(normal.Y());
-            this->normal.push_back(normal.Z());
+        return NumberArray(val::array(estimated));
+    }
+
+    /// @brief Triangles BRepMesh made per shape.
+    NumberArray actualTriangles() const
+    {
+        return NumberArray(val::array(actual));
+    }
+
+    /// @brief False when the estimate stays above the budget even at the coarsest ratio, which the shapes
+    /// are then meshed with.
+    bool budgetMet() const
+    {
+        return isBudgetMet;
+    }
+
+    void release()
+    {
+        for (size_t i = 0; i < shapes.size(); i++) {
+            faceMeshers[i].reset();
+            edgeMeshers[i].reset();
         }
     }
+};
+
+/// @brief nodeId,vertexStart,vertexCount,indexStart,indexCount,faceStart,faceCount,edgeStart,edgeCount,color
+const uint32_t NODE_STRIDE = 10;
+
+/// @brief The faces of an AssemblyMesher reordered so that the nodes of one color are contiguous and draw
+/// with a single call. Every shape of an assembly is meshed in world space, so the color is the only key.
+class ColorBatchMesher {
+public:
+    FaceMesher faceMesher;
+    /// @brief color,vertexStart,vertexCount,indexStart,indexCount per batch
+    std::vector<uint32_t> batches;
+    /// @brief the node id of every face group, for picking
+    std::vector<uint32_t> faceNodes;
 
-    void fillIndex(size_t indexStart, const Handle(Poly_Triangulation) & handlePoly,
-        const TopAbs_Orientation& orientation)
+    ColorBatchMesher(const FaceMesher& source, const std::vector<uint32_t>& nodeTable)
     {
-        for (int index = 0; index < handlePoly->NbTriangles(); index++) {
-            auto v1(1), v2(2), v3(3);
-            if (orientation == TopAbs_REVERSED) {
-                v2 = 3;
-                v3 = 2;
-            }
+        std::vector<const uint32_t*> rows;
+        for (size_t i = 0; i < nodeTable.size(); i += NODE_STRIDE) {
+            rows.push_back(nodeTable.data() + i);
+        }
+        std::stable_sort(rows.begin(), rows.end(), [](const uint32_t* a, const uint32_t* b) { return a[9] < b[9]; });
 
-            auto triangle = handlePoly->Triangle(index + 1);
-            this->index.push_back(triangle.Value(v1) - 1 + indexStart);
-            this->index.push_back(triangle.Value(v2) - 1 + indexStart);
-            this->index.push_back(triangle.Value(v3) - 1 + indexStart);
+        faceMesher.position.reserve(source.position.size());
+        faceMesher.normal.reserve(source.normal.size());
+        faceMesher.uv.reserve(source.uv.size());
+        faceMesher.index.reserve(source.index.size());
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (i == 0 || rows[i][9] != rows[i - 1][9]) {
+                batches.insert(batches.end(),
+                    { rows[i][9], static_cast<uint32_t>(faceMesher.position.size() / 3), 0,
+                        static_cast<uint32_t>(faceMesher.index.size()), 0 });
+            }
+            appendNode(source, rows[i]);
+            batches[batches.size() - 3] = faceMesher.position.size() / 3 - batches[batches.size() - 4];
+            batches[batches.size() - 1] = faceMesher.index.size() - batches[batches.size() - 2];
         }
     }
 
-    void fillUv(const TopoDS_Face& face, const Handle(Poly_Triangulation) & handlePoly)
+private:
+    void appendNode(const FaceMesher& source, const uint32_t* row)
     {
-        double aUmin, aUmax, aVmin, aVmax, dUmax, dVmax;
-        BRepTools::UVBounds(face, aUmin, aUmax, aVmin, aVmax);
-        dUmax = (aUmax - aUmin);
-        dVmax = (aVmax - aVmin);
-        for (int index = 0; index < handlePoly->NbNodes(); index++) {
-            auto uv = handlePoly->UVNode(index + 1);
-            this->uv.push_back((uv.X() - aUmin) / dUmax);
-            this->uv.push_back((uv.Y() - aVmin) / dVmax);
+        uint32_t vertexStart = row[1], vertexCount = row[2], indexStart = row[3], indexCount = row[4];
+        uint32_t newVertexStart = faceMesher.position.size() / 3;
+        uint32_t newIndexStart = faceMesher.index.size();
+        auto append = [](auto& target, const auto& buffer, size_t start, size_t count) {
+            target.insert(target.end(), buffer.begin() + start, buffer.begin() + start + count);
+        };
+        append(faceMesher.position, source.position, vertexStart * 3, vertexCount * 3);
+        append(faceMesher.normal, source.normal, vertexStart * 3, vertexCount * 3);
+        append(faceMesher.uv, source.uv, vertexStart * 2, vertexCount * 2);
+        for (uint32_t i = 0; i < indexCount; i++) {
+            faceMesher.index.push_back(source.index[indexStart + i] - vertexStart + newVertexStart);
+        }
+        for (uint32_t face = row[5]; face < row[5] + row[6]; face++) {
+            faceMesher.faces.push_back(source.faces[face]);
+            faceMesher.group.push_back(source.group[face * 2] - indexStart + newIndexStart);
+            faceMesher.group.push_back(source.group[face * 2 + 1]);
+            faceNodes.push_back(row[0]);
         }
     }
 };
 
-class Mesher {
-    TopoDS_Shape shape;
-    double lineDeflection;
+/// @brief Views over a ColorBatchMesher, see FaceMeshData for their lifetime.
+struct ColorBatchData {
+    std::weak_ptr<ColorBatchMesher> mesher;
+    FaceMeshData faceMeshData;
+
+    /// @brief color,vertexStart,vertexCount,indexStart,indexCount per batch
+    Uint32Array batches() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &ColorBatchMesher::batches);
+    }
+
+    /// @brief the node id of every face group
+    Uint32Array faceNodes() const
+    {
+        return meshBufferView<Uint32Array>(mesher, &ColorBatchMesher::faceNodes);
+    }
+};
 
+/// @brief Meshes every shape of a ShapeNode tree into one set of buffers, so an assembly costs a single call
+/// and a few typed arrays instead of a Mesher per leaf. The nodes are numbered in depth-first order from
+/// the root, which is 0, and nodes table maps every node with a shape to its ranges in the buffers.
+class AssemblyMesher {
 public:
-    Mesher(const TopoDS_Shape& shape, double lineDeflection, bool useBoxRatio)
-        : shape(shape)
+    /// @brief Color of nodes without a color of their own or of an ancestor.
+    static constexpr uint32_t NO_COLOR = 0xFFFFFFFF;
+
+private:
+    std::shared_ptr<FaceMesher> faceMesher;
+    std::shared_ptr<EdgeMesher> edgeMesher;
+    std::shared_ptr<ColorBatchMesher> colorBatchMesher;
+    std::vector<uint32_t> nodeTable;
+
+    static uint32_t parseColor(const std::optional<std::string>& color, uint32_t inherited)
     {
-        if (useBoxRatio) {
-            this->lineDeflection = boundingBoxRatio(shape, lineDeflection, false);
-        } else {
-            this->lineDeflection = lineDeflection;
+        if (!color.has_value() || color->size() != 7 || color->front() != '#') {
+            return inherited;
         }
-        BRepMesh_IncrementalMesh mesh(shape, lineDeflection, true, ANGLE_DEFLECTION, true);
+        return static_cast<uint32_t>(std::strtoul(color->c_str() + 1, nullptr, 16));
     }
 
-    NumberArray edgesMeshPosition()
+    void meshNode(const ShapeNode& node, uint32_t& nodeId, uint32_t color, double lineDeflection, bool useBoxRatio)
     {
-        std::vector<float> position;
-        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> edgeMap;
-        TopExp::MapShapes(shape, TopAbs_EDGE, edgeMap);
-        for (NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher>::Iterator anIt(edgeMap); anIt.More(); anIt.Next()) {
-            TopoDS_Edge edge = TopoDS::Edge(anIt.Value());
-            pointByGCTangential(edge, this->lineDeflection, position);
+        uint32_t id = nodeId++;
+        color = parseColor(node.color, color);
+        if (node.shape.has_value()) {
+            const auto& shape = node.shape.value();
+            uint32_t vertexStart = faceMesher->position.size() / 3;
+            uint32_t indexStart = faceMesher->index.size();
+            uint32_t faceStart = faceMesher->faces.size();
+            uint32_t edgeStart = edgeMesher->edges.size();
+
+            BRepMesh_IncrementalMesh mesh(shape, lineDeflection, true, ANGLE_DEFLECTION, true);
+            std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
+            faceMesher->meshShape(shape, facePolyMap);
+            edgeMesher->lineDeflection = useBoxRatio ? boundingBoxRatio(shape, lineDeflection, false) : lineDeflection;
+            edgeMesher->meshShape(shape, facePolyMap);
+
+            nodeTable.insert(nodeTable.end(),
+                { id, vertexStart, static_cast<uint32_t>(faceMesher->position.size() / 3 - vertexStart), indexStart,
+                    static_cast<uint32_t>(faceMesher->index.size() - indexStart), faceStart,
+                    static_cast<uint32_t>(faceMesher->faces.size() - faceStart), edgeStart,
+                    static_cast<uint32_t>(edgeMesher->edges.size() - edgeStart), color });
         }
+        for (const auto& child : node.children) {
+            meshNode(child, nodeId, color, lineDeflection, useBoxRatio);
+        }
+    }
 
-        return NumberArray(val::array(position));
+public:
+    /// @brief Every shape is triangulated by a BRepMesh run of its own, relative to its own size like Mesher
+    /// does, so small parts of a large assembly are as fine as when meshed alone. Shapes shared by several
+    /// nodes keep the triangulation of the first one. Leaves without a color take the one of their nearest
+    /// ancestor.
+    AssemblyMesher(const ShapeNode& root, double lineDeflection, bool useBoxRatio)
+        : faceMesher(std::make_shared<FaceMesher>())
+        , edgeMesher(std::make_shared<EdgeMesher>(lineDeflection))
+    {
+        uint32_t nodeId = 0;
+        meshNode(root, nodeId, NO_COLOR, lineDeflection, useBoxRatio);
     }
 
-    MeshData mesh()
+    /// @brief The shapes become the children of a root without shape, so their node ids start at 1.
+    static AssemblyMesher fromShapes(const ShapeArray& shapes, double lineDeflection, bool useBoxRatio)
     {
-        std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)> facePolyMap;
-        auto faceMeshData = meshFaces(facePolyMap);
-        auto edgeMeshData = meshEdges(facePolyMap);
+        ShapeNode root;
+        for (const auto& shape : vecFromJSArray<TopoDS_Shape>(shapes)) {
+            root.children.push_back(ShapeNode { .shape = shape, .color = std::nullopt, .children = {}, .name = "" });
+        }
+        return AssemblyMesher(root, lineDeflection, useBoxRatio);
+    }
 
-        return MeshData { edgeMeshData, faceMeshData };
+    MeshData mesh() const
+    {
+        if (!faceMesher) {
+            return MeshData { EdgeMeshData { edgeMesher, EdgeArray(val::array()) },
+                FaceMeshData { faceMesher, FaceArray(val::array()) } };
+        }
+        return MeshData { EdgeMeshData { edgeMesher, EdgeArray(val::array(edgeMesher->edges)) },
+            FaceMeshData { faceMesher, FaceArray(val::array(faceMesher->faces)) } };
     }
 
-    EdgeMeshData meshEdges(std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    /// @brief Copies the faces into one batch per color. The edges stay in mesh, their groups are per node.
+    ColorBatchData mergeByColor()
     {
-        EdgeMesher mesher(lineDeflection);
-        NCollection_IndexedDataMap<TopoDS_Shape, NCollection_List<TopoDS_Shape>, TopTools_ShapeMapHasher> mapEF;
-        TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, mapEF);
-        for (int ie = 1; ie <= mapEF.Extent(); ie++) {
-            const TopoDS_Edge& aEdge = TopoDS::Edge(mapEF.FindKey(ie));
-            mesher.edges.push_back(aEdge);
+        if (!faceMesher) {
+            return ColorBatchData { colorBatchMesher, FaceMeshData { {}, FaceArray(val::array()) } };
+        }
+        colorBatchMesher = std::make_shared<ColorBatchMesher>(*faceMesher, nodeTable);
+        std::shared_ptr<FaceMesher> faces(colorBatchMesher, &colorBatchMesher->faceMesher);
+        return ColorBatchData { colorBatchMesher, FaceMeshData { faces, FaceArray(val::array(faces->faces)) } };
+    }
 
-            const NCollection_List<TopoDS_Shape>& aFaces = mapEF(ie);
-            if (aFaces.Extent() < 1) {
-                mesher.generateEdgeMesh(aEdge, nullptr);
-            } else {
-                const TopoDS_Face& face = TopoDS::Face(aFaces.First());
-                auto it = facePolyMap.find(face);
-                if (it != facePolyMap.end()) {
-                    mesher.generateEdgeMesh(aEdge, it->second);
-                } else {
-                    mesher.generateEdgeMesh(aEdge, nullptr);
+    /// @brief NODE_STRIDE entries per node with a shape: nodeId,vertexStart,vertexCount,indexStart,indexCount,
+    /// faceStart,faceCount,edgeStart,edgeCount,color. Vertices and indices count in vertices and index entries of the face buffers,
+    /// faces and edges in their groups, color is 0xRRGGBB or 0xFFFFFFFF for none.
+    Uint32Array nodes() const
+    {
+        return typedArrayView<Uint32Array>(nodeTable);
+    }
+
+    void release()
+    {
+        faceMesher.reset();
+        edgeMesher.reset();
+        colorBatchMesher.reset();
+        nodeTable = std::vector<uint32_t>();
+    }
+};
+
+struct MeshRayHit {
+    uint32_t face;
+    /// @brief Counted within the face group.
+    uint32_t triangle;
+    /// @brief Barycentrics of the second and third corner.
+    double u;
+    double v;
+    double distance;
+    Vector3 point;
+};
+
+struct MeshEdgeHit {
+    uint32_t edge;
+    /// @brief Counted within the edge group.
+    uint32_t segment;
+    /// @brief 0 at the first point of the segment, 1 at the second one.
+    double parameter;
+    /// @brief Distance of the point from the ray.
+    double distance;
+    Vector3 point;
+};
+
+/// @brief Hierarchies over the triangles of a FaceMeshData and the segments of an EdgeMeshData for picking
+/// without walking the meshes in JS. The geometry is copied in, so every layout and index option of Mesher
+/// works and the mesher can be released. Ray directions need not be unit length, distances are in model units.
+class MeshBvh {
+    /// @brief 9 floats per triangle and 6 per segment, in the order of the leaves.
+    std::vector<float> triangles;
+    std::vector<float> segments;
+    /// @brief face,triangle or edge,segment per primitive, in the same order.
+    std::vector<uint32_t> triangleIds;
+    std::vector<uint32_t> segmentIds;
+    std::vector<uint32_t> faceTriangleCounts;
+    std::vector<uint32_t> edgeSegmentCounts;
+    Bvh triangleBvh;
+    Bvh segmentBvh;
+
+    /// @brief Position of vertex i, from position or from the first 12 bytes of the interleaved vertices.
+    static const float* vertexPosition(const FaceMesher& mesher, uint32_t i)
+    {
+        if (!mesher.position.empty()) {
+            return mesher.position.data() + i * 3;
+        }
+        return reinterpret_cast<const float*>(mesher.vertices.data() + static_cast<size_t>(i) * mesher.vertexStride);
+    }
+
+    void addTriangles(const FaceMesher& mesher)
+    {
+        faceTriangleCounts.assign(mesher.faces.size(), 0);
+        auto add = [&](uint32_t face, uint32_t triangle, uint32_t i0, uint32_t i1, uint32_t i2) {
+            for (auto i : { i0, i1, i2 }) {
+                const float* p = vertexPosition(mesher, i);
+                triangles.insert(triangles.end(), p, p + 3);
+            }
+            triangleIds.push_back(face);
+            triangleIds.push_back(triangle);
+            faceTriangleCounts[face]++;
+        };
+
+        const auto& indexGroup = mesher.groupIndex.indexGroup;
+        if (mesher.index.empty() && !indexGroup.empty()) {
+            for (uint32_t face = 0; face * 4 + 3 < indexGroup.size() && face < mesher.faces.size(); face++) {
+                uint32_t baseVertex = indexGroup[face * 4], vertexCount = indexGroup[face * 4 + 1];
+                uint32_t start = indexGroup[face * 4 + 2], count = indexGroup[face * 4 + 3];
+                const auto& groupIndex = mesher.groupIndex;
+                auto at = [&](uint32_t k) {
+                    uint32_t local = vertexCount < 65536 ? groupIndex.index16[start + k] : groupIndex.index32[start + k];
+                    return baseVertex + local;
+                };
+                for (uint32_t k = 0; k + 2 < count; k += 3) {
+                    add(face, k / 3, at(k), at(k + 1), at(k + 2));
                 }
             }
+            return;
+        }
+        for (uint32_t face = 0; face * 2 + 1 < mesher.group.size() && face < mesher.faces.size(); face++) {
+            const uint32_t* index = mesher.index.data() + mesher.group[face * 2];
+            for (uint32_t k = 0; k + 2 < mesher.group[face * 2 + 1]; k += 3) {
+                add(face, k / 3, index[k], index[k + 1], index[k + 2]);
+            }
         }
+    }
 
-        return EdgeMeshData { NumberArray(val::array(mesher.position)), NumberArray(val::array(mesher.group)),
-            EdgeArray(val::array(mesher.edges)) };
+    void addSegments(const EdgeMesher& mesher)
+    {
+        edgeSegmentCounts.assign(mesher.group.size() / 2, 0);
+        for (uint32_t edge = 0; edge * 2 + 1 < mesher.group.size(); edge++) {
+            uint32_t start = mesher.group[edge * 2], count = mesher.group[edge * 2 + 1];
+            for (uint32_t k = 0; k + 1 < count; k += 2) {
+                uint32_t a = mesher.isIndexed ? mesher.index[start + k] : start + k;
+                uint32_t b = mesher.isIndexed ? mesher.index[start + k + 1] : start + k + 1;
+                segments.insert(segments.end(), mesher.position.begin() + a * 3, mesher.position.begin() + a * 3 + 3);
+                segments.insert(segments.end(), mesher.position.begin() + b * 3, mesher.position.begin() + b * 3 + 3);
+                segmentIds.push_back(edge);
+                segmentIds.push_back(k / 2);
+                edgeSegmentCounts[edge]++;
+            }
+        }
     }
 
-    FaceMeshData meshFaces(std::unordered_map<TopoDS_Face, Handle(Poly_Triangulation)>& facePolyMap)
+    /// @brief Builds the hierarchy over primitives of stride floats and stores them in the order of the
+    /// leaves, so a leaf reads one contiguous block.
+    static void build(Bvh& bvh, std::vector<float>& data, std::vector<uint32_t>& ids, size_t stride)
     {
-        FaceMesher mesher;
-        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
-        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
-        for (NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher>::Iterator anIt(faceMap); anIt.More(); anIt.Next()) {
-            auto face = TopoDS::Face(anIt.Value());
-            TopLoc_Location location;
-            auto handlePoly = BRep_Tool::Triangulation(face, location);
-            if (!handlePoly.IsNull()) {
-                auto trsf = location.Transformation();
-                mesher.faces.push_back(face);
-                mesher.generateFaceMesh(face, handlePoly, trsf);
-                facePolyMap[face] = handlePoly;
+        size_t count = ids.size() / 2;
+        std::vector<BvhBox> boxes(count);
+        for (size_t i = 0; i < count; i++) {
+            for (size_t k = 0; k < stride; k += 3) {
+                boxes[i].grow(data.data() + i * stride + k);
             }
         }
+        bvh.build(boxes);
+
+        std::vector<float> orderedData(data.size());
+        std::vector<uint32_t> orderedIds(ids.size());
+        for (size_t i = 0; i < count; i++) {
+            uint32_t p = bvh.primitives[i];
+            std::copy_n(data.begin() + p * stride, stride, orderedData.begin() + i * stride);
+            std::copy_n(ids.begin() + p * 2, 2, orderedIds.begin() + i * 2);
+            bvh.primitives[i] = i;
+        }
+        data = std::move(orderedData);
+        ids = std::move(orderedIds);
+    }
+
+    static BvhRay makeRay(const Vector3& origin, const Vector3& direction)
+    {
+        double length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+        float o[3] = { static_cast<float>(origin.x), static_cast<float>(origin.y), static_cast<float>(origin.z) };
+        float d[3] = { static_cast<float>(direction.x / length), static_cast<float>(direction.y / length),
+            static_cast<float>(direction.z / length) };
+        return BvhRay(o, d);
+    }
+
+    static Vector3 pointAt(const BvhRay& ray, double t)
+    {
+        return Vector3 { ray.origin[0] + ray.direction[0] * t, ray.origin[1] + ray.direction[1] * t,
+            ray.origin[2] + ray.direction[2] * t };
+    }
+
+    static BvhPlanes toPlanes(const NumberArray& planes)
+    {
+        return BvhPlanes { vecFromJSArray<float>(planes) };
+    }
+
+public:
+    MeshBvh(const FaceMeshData& faces, const EdgeMeshData& edges)
+    {
+        if (auto mesher = faces.mesher.lock()) {
+            addTriangles(*mesher);
+        }
+        if (auto mesher = edges.mesher.lock()) {
+            addSegments(*mesher);
+        }
+        build(triangleBvh, triangles, triangleIds, 9);
+        build(segmentBvh, segments, segmentIds, 6);
+    }
+
+    size_t triangleCount() const
+    {
+        return triangleIds.size() / 2;
+    }
+
+    size_t segmentCount() const
+    {
+        return segmentIds.size() / 2;
+    }
+
+    /// @brief The first triangle along the ray, both sides of the triangles count.
+    std::optional<MeshRayHit> raycast(const Vector3& origin, const Vector3& direction) const
+    {
+        auto ray = makeRay(origin, direction);
+        std::optional<MeshRayHit> result;
+        float nearest = std::numeric_limits<float>::infinity();
+        triangleBvh.traverse([&](const BvhBox& box) { return ray.enter(box, 0, nearest); },
+            [&](uint32_t i) {
+                const float* p = triangles.data() + i * 9;
+                float t, u, v;
+                if (intersectTriangle(ray, p, p + 3, p + 6, t, u, v) && t < nearest) {
+                    nearest = t;
+                    result = MeshRayHit { triangleIds[i * 2], triangleIds[i * 2 + 1], u, v, t, pointAt(ray, t) };
+                }
+                return nearest;
+            });
+        return result;
+    }
+
+    /// @brief The edge segment that passes closest to the ray relative to the tolerance there, which is
+    /// tolerance + tolerancePerDistance times the distance along the ray. For a pixel tolerance, an orthographic
+    /// camera passes the size of the pixels in model units as tolerance, a perspective one the pixel size at
+    /// distance 1 as tolerancePerDistance.
+    std::optional<MeshEdgeHit> nearestEdge(const Vector3& origin, const Vector3& direction, double tolerance,
+        double tolerancePerDistance) const
+    {
+        auto ray = makeRay(origin, direction);
+        std::optional<MeshEdgeHit> result;
+        float best = 1;
+        segmentBvh.traverse(
+            [&](const BvhBox& box) {
+                // no point of the box is farther along the ray than its farthest corner
+                float far = 0;
+                for (int k = 0; k < 3; k++) {
+                    float d = std::max(std::abs(box.min[k] - ray.origin[k]), std::abs(box.max[k] - ray.origin[k]));
+                    far += d * d;
+                }
+                float margin = static_cast<float>(tolerance + tolerancePerDistance * std::sqrt(far));
+                return ray.enter(box, margin, std::numeric_limits<float>::infinity());
+            },
+            [&](uint32_t i) {
+                const float* p = segments.data() + i * 6;
+                float t, s;
+                float distance = std::sqrt(closestRaySegment(ray, p, p + 3, t, s));
+                float ratio = distance / static_cast<float>(tolerance + tolerancePerDistance * t);
+                if (ratio < best || (!result && ratio <= best)) {
+                    best = ratio;
+                    float point[3] = { p[0] + (p[3] - p[0]) * s, p[1] + (p[4] - p[1]) * s, p[2] + (p[5] - p[2]) * s };
+                    result = MeshEdgeHit { segmentIds[i * 2], segmentIds[i * 2 + 1], s, distance,
+                        Vector3 { point[0], point[1], point[2] } };
+                }
+                return std::numeric_limits<float>::infinity();
+            });
+        return result;
+    }
 
-        return FaceMeshData { NumberArray(val::array(mesher.position)), NumberArray(val::array(mesher.normal)),
-            NumberArray(val::array(mesher.uv)), NumberArray(val::array(mesher.index)),
-            NumberArray(val::array(mesher.group)), FaceArray(val::array(mesher.faces)) };
+    /// @brief Faces with a triangle in the volume bounded by planes, a,b,c,d per plane with ax + by + cz + d >= 0
+    /// inside: six planes for a frustum or a box. With contained, only faces whose triangles all lie inside.
+    /// Triangles crossing the boundary are clipped against the volume, so only those that touch it count.
+    NumberArray selectFaces(const NumberArray& planes, bool contained) const
+    {
+        return select(triangleBvh, triangles, triangleIds, faceTriangleCounts, 3, toPlanes(planes), contained);
+    }
+
+    /// @brief Same as selectFaces for the edges.
+    NumberArray selectEdges(const NumberArray& planes, bool contained) const
+    {
+        return select(segmentBvh, segments, segmentIds, edgeSegmentCounts, 2, toPlanes(planes), contained);
+    }
+
+    void release()
+    {
+        triangles = std::vector<float>();
+        segments = std::vector<float>();
+        triangleIds = std::vector<uint32_t>();
+        segmentIds = std::vector<uint32_t>();
+        faceTriangleCounts = std::vector<uint32_t>();
+        edgeSegmentCounts = std::vector<uint32_t>();
+        triangleBvh = Bvh();
+        segmentBvh = Bvh();
+    }
+
+private:
+    static NumberArray select(const Bvh& bvh, const std::vector<float>& data, const std::vector<uint32_t>& ids,
+        const std::vector<uint32_t>& groupCounts, int points, const BvhPlanes& planes, bool contained)
+    {
+        std::vector<uint32_t> hits(groupCounts.size(), 0);
+        bvh.traverse(
+            [&](const BvhBox& box) { return planes.isOutside(box) ? std::numeric_limits<float>::infinity() : 0.0f; },
+            [&](uint32_t i) {
+                const float* p = data.data() + i * points * 3;
+                const float* corners[3] = { p, p + 3, p + 6 };
+                bool inside = true;
+                for (int k = 0; k < points && inside; k++) {
+                    inside = planes.contains(corners[k]);
+                }
+                if (contained ? inside : inside || planes.intersects(corners, points)) {
+                    hits[ids[i * 2]]++;
+                }
+                return std::numeric_limits<float>::infinity();
+            });
+
+        std::vector<uint32_t> result;
+        for (uint32_t group = 0; group < hits.size(); group++) {
+            if (contained ? hits[group] == groupCounts[group] && hits[group] > 0 : hits[group] > 0) {
+                result.push_back(group);
+            }
+        }
+        return NumberArray(val::array(result));
     }
 };
 
 EMSCRIPTEN_BINDINGS(Mesher)
 {
+    enum_<VertexLayout>("VertexLayout")
+        .value("Separate", VertexLayout::Separate)
+        .value("Interleaved", VertexLayout::Interleaved)
+        .value("Packed", VertexLayout::Packed);
+
     class_<Mesher>("Mesher")
         .constructor<TopoDS_Shape, double, bool>()
+        .constructor<TopoDS_Shape, double, bool, double>()
+        .constructor<TopoDS_Shape, double, bool, TopoDS_Shape, Handle(BRepTools_History)>()
+        .property("compactIndex", &Mesher::getCompactIndex, &Mesher::setCompactIndex)
+        .property("indexedEdges", &Mesher::getIndexedEdges, &Mesher::setIndexedEdges)
+        .property("vertexLayout", &Mesher::getVertexLayout, &Mesher::setVertexLayout)
+        .property("optimizeVertexCache", &Mesher::getOptimizeVertexCache, &Mesher::setOptimizeVertexCache)
+        .property("localSpace", &Mesher::getLocalSpace, &Mesher::setLocalSpace)
+        .property("decimated", &Mesher::getDecimated)
+        .property("changedFaces", &Mesher::getChangedFaces)
         .function("mesh", &Mesher::mesh)
+        .function("meshDecimated", &Mesher::meshDecimated)
+        .function("meshInstanced", &Mesher::meshInstanced)
+        .function("meshLevels", &Mesher::meshLevels)
+        .function("meshQuantized", &Mesher::meshQuantized)
+        .function("release", &Mesher::release)
+        .function("locationMatrix", &Mesher::locationMatrix)
         .function("edgesMeshPosition", &Mesher::edgesMeshPosition);
 
+    class_<EdgeBatchMesher>("EdgeBatchMesher")
+        .constructor<ShapeArray, double, bool>()
+        .function("mesh", &EdgeBatchMesher::mesh)
+        .function("shapes", &EdgeBatchMesher::shapes)
+        .function("release", &EdgeBatchMesher::release);
+
+    class_<MeshStream>("MeshStream")
+        .constructor<TopoDS_Shape, double, bool, size_t>()
+        .property("faceCount", &MeshStream::faceCount)
+        .property("sentFaces", &MeshStream::sentFaces)
+        .function("next", &MeshStream::next)
+        .function("release", &MeshStream::release);
+
+    register_optional<MeshData>();
+
+    class_<MeshJob>("MeshJob")
+        .constructor<TopoDS_Shape, double, bool>()
+        .property("progress", &MeshJob::progress)
+        .property("finished", &MeshJob::finished)
+        .property("cancelled", &MeshJob::cancelled)
+        .function("step", &MeshJob::step)
+        .function("cancel", &MeshJob::cancel)
+        .function("mesh", &MeshJob::mesh)
+        .function("release", &MeshJob::release);
+
+    class_<SceneMesher>("SceneMesher")
+        .constructor<ShapeArray, double, bool, double>()
+        .class_function("trianglesForBytes", &SceneMesher::trianglesForBytes)
+        .function("mesh", &SceneMesher::mesh)
+        .function("estimatedTriangles", &SceneMesher::estimatedTriangles)
+        .function("actualTriangles", &SceneMesher::actualTriangles)
+        .property("budgetMet", &SceneMesher::budgetMet)
+        .function("release", &SceneMesher::release);
+
+    class_<AssemblyMesher>("AssemblyMesher")
+        .constructor<ShapeNode, double, bool>()
+        .class_function("fromShapes", &AssemblyMesher::fromShapes)
+        .function("mesh", &AssemblyMesher::mesh)
+        .function("nodes", &AssemblyMesher::nodes)
+        .function("mergeByColor", &AssemblyMesher::mergeByColor)
+        .function("release", &AssemblyMesher::release);
+
+    value_object<MeshRayHit>("MeshRayHit")
+        .field("face", &MeshRayHit::face)
+        .field("triangle", &MeshRayHit::triangle)
+        .field("u", &MeshRayHit::u)
+        .field("v", &MeshRayHit::v)
+        .field("distance", &MeshRayHit::distance)
+        .field("point", &MeshRayHit::point);
+    register_optional<MeshRayHit>();
+
+    value_object<MeshEdgeHit>("MeshEdgeHit")
+        .field("edge", &MeshEdgeHit::edge)
+        .field("segment", &MeshEdgeHit::segment)
+        .field("parameter", &MeshEdgeHit::parameter)
+        .field("distance", &MeshEdgeHit::distance)
+        .field("point", &MeshEdgeHit::point);
+    register_optional<MeshEdgeHit>();
+
+    class_<MeshBvh>("MeshBvh")
+        .constructor<FaceMeshData, EdgeMeshData>()
+        .property("triangleCount", &MeshBvh::triangleCount)
+        .property("segmentCount", &MeshBvh::segmentCount)
+        .function("raycast", &MeshBvh::raycast)
+        .function("nearestEdge", &MeshBvh::nearestEdge)
+        .function("selectFaces", &MeshBvh::selectFaces)
+        .function("selectEdges", &MeshBvh::selectEdges)
+        .function("release", &MeshBvh::release);
+
+    class_<MeshCache>("MeshCache")
+        .class_function("hits", &MeshCache::hits)
+        .class_function("misses", &MeshCache::misses)
+        .class_function("size", &MeshCache::size)
+        .class_function("setCapacity", &MeshCache::setCapacity)
+        .class_function("clear", &MeshCache::clear);
+
     class_<EdgeMeshData>("EdgeMeshData")
         .property("position", &EdgeMeshData::position)
+        .property("index", &EdgeMeshData::index)
         .property("group", &EdgeMeshData::group)
         .property("edges", &EdgeMeshData::edges);
 
@@ -320,9 +2486,53 @@ EMSCRIPTEN_BINDINGS(Mesher)
         .property("uv", &FaceMeshData::uv)
         .property("index", &FaceMeshData::index)
         .property("group", &FaceMeshData::group)
+        .property("index16", &FaceMeshData::index16)
+        .property("index32", &FaceMeshData::index32)
+        .property("indexGroup", &FaceMeshData::indexGroup)
+        .property("vertices", &FaceMeshData::vertices)
+        .property("vertexStride", &FaceMeshData::vertexStride)
         .property("faces", &FaceMeshData::faces);
 
     class_<MeshData>("MeshData")
         .property("edgeMeshData", &MeshData::edgeMeshData)
         .property("faceMeshData", &MeshData::faceMeshData);
+
+    class_<InstancedMeshData>("InstancedMeshData")
+        .property("edgeMeshData", &InstancedMeshData::edgeMeshData)
+        .property("faceMeshData", &InstancedMeshData::faceMeshData)
+        .property("prototypes", &InstancedMeshData::prototypes)
+        .property("meshes", &InstancedMeshData::meshes)
+        .property("instanceMesh", &InstancedMeshData::instanceMesh)
+        .property("instanceMatrix", &InstancedMeshData::instanceMatrix);
+
+    class_<QuantizedFaceMeshData>("QuantizedFaceMeshData")
+        .property("position", &QuantizedFaceMeshData::position)
+        .property("normal", &QuantizedFaceMeshData::normal)
+        .property("uv", &QuantizedFaceMeshData::uv)
+        .property("index", &QuantizedFaceMeshData::index)
+        .property("group", &QuantizedFaceMeshData::group)
+        .property("positionOffset", &QuantizedFaceMeshData::positionOffset)
+        .property("positionScale", &QuantizedFaceMeshData::positionScale)
+        .property("index16", &QuantizedFaceMeshData::index16)
+        .property("index32", &QuantizedFaceMeshData::index32)
+        .property("indexGroup", &QuantizedFaceMeshData::indexGroup)
+        .property("faces", &QuantizedFaceMeshData::faces);
+
+    class_<QuantizedMeshData>("QuantizedMeshData")
+        .property("edgeMeshData", &QuantizedMeshData::edgeMeshData)
+        .property("faceMeshData", &QuantizedMeshData::faceMeshData);
+
+    class_<ColorBatchData>("ColorBatchData")
+        .property("faceMeshData", &ColorBatchData::faceMeshData)
+        .property("batches", &ColorBatchData::batches)
+        .property("faceNodes", &ColorBatchData::faceNodes);
+
+    class_<LodMeshData>("LodMeshData")
+        .property("faces", &LodMeshData::faces)
+        .property("deflections", &LodMeshData::deflections)
+        .property("position", &LodMeshData::position)
+        .property("normal", &LodMeshData::normal)
+        .property("uv", &LodMeshData::uv)
+        .function("index", &LodMeshData::index)
+        .function("group", &LodMeshData::group);
 }
@@ -3,6 +3,7 @@
 
 #include <emscripten/bind.h>
 
+#include <BRepTools_History.hxx>
 #include <BRep_Tool.hxx>
 #include <GeomAbs_JoinType.hxx>
 #include <GeomAbs_Shape.hxx>
@@ -298,12 +299,18 @@ EMSCRIPTEN_BINDINGS(opencascade)
         .function("setDirection", &Geom_SurfaceOfRevolution::SetDirection)
         .function("referencePlane", &Geom_SurfaceOfRevolution::ReferencePlane);
 
+    class_<BRepTools_History, base<Standard_Transient>>("BRepTools_History")
+        .function("hasModified", &BRepTools_History::HasModified)
+        .function("hasGenerated", &BRepTools_History::HasGenerated)
+        .function("hasRemoved", &BRepTools_History::HasRemoved);
+
     REGISTER_HANDLE(Standard_Transient);
     REGISTER_HANDLE(Geom_Geometry);
     REGISTER_HANDLE(Geom_Curve);
     REGISTER_HANDLE(Geom_Line);
     REGISTER_HANDLE(Geom_TrimmedCurve);
     REGISTER_HANDLE(Geom_Surface);
+    REGISTER_HANDLE(BRepTools_History);
 
     class_<gp_Pnt>("gp_Pnt")
         .constructor<double, double, double>()
@@ -0,0 +1,53 @@
+// Part of the Chili3d Project, under the LGPL-3.0 License.
+// See LICENSE-chili-wasm.text file in the project root for full license information.
+
+#include <emscripten/bind.h>
+#include <emscripten/val.h>
+
+#include <OSD_Parallel.hxx>
+#include <OSD_ThreadPool.hxx>
+
+using namespace emscripten;
+
+/// @brief Controls the OCCT thread pool used by BRepMesh, booleans and defeaturing.
+/// In the single-threaded build the pool always has one thread and the setters are ignored.
+class Parallel {
+public:
+    static bool isThreaded()
+    {
+#ifdef __EMSCRIPTEN_PTHREADS__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static int logicalProcessors()
+    {
+        return isThreaded() ? OSD_Parallel::NbLogicalProcessors() : 1;
+    }
+
+    static int threadCount()
+    {
+        return isThreaded() ? OSD_ThreadPool::DefaultPool()->NbThreads() : 1;
+    }
+
+    /// @brief Should match the pthread pool size the module was started with,
+    /// otherwise the extra workers are spawned lazily and block the caller.
+    static void setThreadCount(int count)
+    {
+        if (!isThreaded() || count < 1) {
+            return;
+        }
+        OSD_ThreadPool::DefaultPool()->Init(count);
+    }
+};
+
+EMSCRIPTEN_BINDINGS(Parallel)
+{
+    class_<Parallel>("Parallel")
+        .class_function("isThreaded", &Parallel::isThreaded)
+        .class_function("logicalProcessors", &Parallel::logicalProcessors)
+        .class_function("threadCount", &Parallel::threadCount)
+        .class_function("setThreadCount", &Parallel::setThreadCount);
+}
@@ -23,6 +23,7 @@
 #include <BRepTools_WireExplorer.hxx>
 #include <BRep_Builder.hxx>
 #include <BRep_Tool.hxx>
+#include <Bnd_Box.hxx>
 #include <Bnd_OBB.hxx>
 #include <GCPnts_AbscissaPoint.hxx>
 #include <GProp_GProps.hxx>
@@ -50,8 +51,12 @@
 #include <TopoDS_Wire.hxx>
 #include <gp_Ax3.hxx>
 #include <gp_Dir.hxx>
+#include <gp_Lin.hxx>
 #include <gp_Pnt.hxx>
+#include <cmath>
+#include <limits>
 
+#include "bvh.hpp"
 #include "shared.hpp"
 #include "utils.hpp"
 #include <BRepCheck_Analyzer.hxx>
@@ -150,19 +155,25 @@ public:
         return section.Shape();
     }
 
-    static TopoDS_Shape splitShapes(const ShapeArray &arguments, const ShapeArray &tools, double tolerance)
+    /// @brief The history lets Mesher re-mesh only the faces the split changed.
+    static ShapeResult splitShapes(const ShapeArray &arguments, const ShapeArray &tools, double tolerance)
     {
         NCollection_List<TopoDS_Shape> argumentsList = shapeArrayToListOfShape(arguments);
         NCollection_List<TopoDS_Shape> toolsList = shapeArrayToListOfShape(tools);
         BRepAlgoAPI_Splitter splitter;
         splitter.SetFuzzyValue(tolerance);
-        splitter.SetToFillHistory(false);
+        splitter.SetToFillHistory(true);
         splitter.SetArguments(argumentsList);
         splitter.SetTools(toolsList);
         splitter.SimplifyResult();
+        splitter.SetRunParallel(true);
         splitter.Build();
+        if (!splitter.IsDone())
+        {
+            return ShapeResult{TopoDS_Shape(), false, "Failed to split shapes"};
+        }
 
-        return splitter.Shape();
+        return ShapeResult{splitter.Shape(), true, "", splitter.History()};
     }
 
     static std::optional<TopoDS_Shape> removeFeature(const TopoDS_Shape &shape, const ShapeArray &faces)
@@ -708,6 +719,134 @@ public:
     }
 };
 
+struct ShapeRayHit
+{
+    TopoDS_Face face;
+    /// @brief Index of the face in the order of TopExp::MapShapes.
+    int faceIndex;
+    double u;
+    double v;
+    /// @brief Distance from the origin of the ray.
+    double parameter;
+    Vector3 point;
+};
+
+/// @brief Exact ray casting on the faces of a shape. Face::intersectLine sets up the classifier of its face
+/// on every call, here every face gets its IntCurvesFace_Intersector once, and a Bvh over the face boxes
+/// leaves out the faces the ray misses. Keep one per shape while it is picked on and release it afterwards.
+class ShapeRayCaster
+{
+private:
+    std::vector<TopoDS_Face> faces;
+    std::vector<int> faceIndices;
+    std::vector<Handle(IntCurvesFace_Intersector)> intersectors;
+    Bvh bvh;
+
+    /// @brief Rounds outwards, so the float box still contains the double one.
+    static BvhBox toBvhBox(const Bnd_Box &box)
+    {
+        double min[3], max[3];
+        box.Get(min[0], min[1], min[2], max[0], max[1], max[2]);
+        BvhBox result;
+        for (int i = 0; i < 3; i++)
+        {
+            result.min[i] = std::nextafter(static_cast<float>(min[i]), -std::numeric_limits<float>::infinity());
+            result.max[i] = std::nextafter(static_cast<float>(max[i]), std::numeric_limits<float>::infinity());
+        }
+        return result;
+    }
+
+    /// @brief The hit with the smallest parameter from minParameter on.
+    std::optional<ShapeRayHit> intersect(const Vector3 &point, const Vector3 &direction, double minParameter)
+    {
+        gp_Lin line(Vector3::toPnt(point), Vector3::toDir(direction));
+        float origin[3] = {static_cast<float>(point.x), static_cast<float>(point.y), static_cast<float>(point.z)};
+        float dir[3] = {static_cast<float>(line.Direction().X()), static_cast<float>(line.Direction().Y()),
+                        static_cast<float>(line.Direction().Z())};
+        BvhRay ray(origin, dir);
+
+        std::optional<ShapeRayHit> result;
+        double nearest = 1e12;
+        bvh.traverse([&](const BvhBox &box)
+                     { return ray.enter(box, 0, static_cast<float>(nearest), static_cast<float>(minParameter)); },
+                     [&](uint32_t i)
+                     {
+                         auto &intersector = intersectors[i];
+                         intersector->Perform(line, minParameter, nearest);
+                         if (intersector->IsDone())
+                         {
+                             for (int k = 1; k <= intersector->NbPnt(); k++)
+                             {
+                                 if (intersector->WParameter(k) < nearest)
+                                 {
+                                     nearest = intersector->WParameter(k);
+                                     result = ShapeRayHit{faces[i], faceIndices[i], intersector->UParameter(k),
+                                                          intersector->VParameter(k), nearest,
+                                                          Vector3::fromPnt(intersector->Pnt(k))};
+                                 }
+                             }
+                         }
+                         return std::nextafter(static_cast<float>(nearest), std::numeric_limits<float>::infinity());
+                     });
+        return result;
+    }
+
+public:
+    ShapeRayCaster(const TopoDS_Shape &shape, double tolerance)
+    {
+        Bnd_Box shapeBox;
+        BRepBndLib::Add(shape, shapeBox, false);
+        // the ray is tested against the boxes in float, this covers its rounding
+        double gap = shapeBox.IsVoid() ? 0 : std::sqrt(shapeBox.SquareExtent()) * 1e-5;
+
+        NCollection_IndexedMap<TopoDS_Shape, TopTools_ShapeMapHasher> faceMap;
+        TopExp::MapShapes(shape, TopAbs_FACE, faceMap);
+        std::vector<BvhBox> boxes;
+        for (int i = 1; i <= faceMap.Extent(); i++)
+        {
+            auto face = TopoDS::Face(faceMap(i));
+            Bnd_Box box;
+            BRepBndLib::Add(face, box, false);
+            if (box.IsVoid())
+            {
+                continue;
+            }
+            box.Enlarge(tolerance + gap);
+            boxes.push_back(toBvhBox(box));
+            faces.push_back(face);
+            faceIndices.push_back(i - 1);
+            intersectors.push_back(new IntCurvesFace_Intersector(face, tolerance));
+        }
+        bvh.build(boxes);
+    }
+
+    size_t faceCount() const
+    {
+        return faces.size();
+    }
+
+    /// @brief The nearest face hit by the ray from point along direction.
+    std::optional<ShapeRayHit> intersectRay(const Vector3 &point, const Vector3 &direction)
+    {
+        return intersect(point, direction, 0);
+    }
+
+    /// @brief The first face hit along the whole line through point, also behind it, with the range
+    /// Face::intersectLine searches. The parameter of the hit is negative when it lies behind point.
+    std::optional<ShapeRayHit> intersectLine(const Vector3 &point, const Vector3 &direction)
+    {
+        return intersect(point, direction, -1e12);
+    }
+
+    void release()
+    {
+        faces = std::vector<TopoDS_Face>();
+        faceIndices = std::vector<int>();
+        intersectors = std::vector<Handle(IntCurvesFace_Intersector)>();
+        bvh = Bvh();
+    }
+};
+
 EMSCRIPTEN_BINDINGS(Shape)
 {
     class_<Shape>("Shape")
@@ -763,4 +902,20 @@ EMSCRIPTEN_BINDINGS(Shape)
     class_<Solid>("Solid")
         .class_function("volume", &Solid::volume)
         .class_function("containsPoint", &Solid::containsPoint);
+
+    value_object<ShapeRayHit>("ShapeRayHit")
+        .field("face", &ShapeRayHit::face)
+        .field("faceIndex", &ShapeRayHit::faceIndex)
+        .field("u", &ShapeRayHit::u)
+        .field("v", &ShapeRayHit::v)
+        .field("parameter", &ShapeRayHit::parameter)
+        .field("point", &ShapeRayHit::point);
+    register_optional<ShapeRayHit>();
+
+    class_<ShapeRayCaster>("ShapeRayCaster")
+        .constructor<TopoDS_Shape, double>()
+        .property("faceCount", &ShapeRayCaster::faceCount)
+        .function("intersectRay", &ShapeRayCaster::intersectRay)
+        .function("intersectLine", &ShapeRayCaster::intersectLine)
+        .function("release", &ShapeRayCaster::release);
 }
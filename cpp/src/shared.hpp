@@ -6,6 +6,8 @@
 #include <emscripten/bind.h>
 #include <emscripten/val.h>
 
+#include <BRepTools_History.hxx>
+#include <TopoDS_Shape.hxx>
 #include <gp_Ax1.hxx>
 #include <gp_Ax2.hxx>
 #include <gp_Ax3.hxx>
@@ -14,6 +16,10 @@
 #include <gp_Pnt.hxx>
 #include <gp_Vec.hxx>
 
+#include <optional>
+#include <string>
+#include <vector>
+
 #define STR(x) #x
 #define REGISTER_HANDLE(T)                                                   \
     class_<opencascade::handle<T>>(STR(Handle_##T))                          \
@@ -198,6 +204,14 @@ struct ExtremaCCResult {
     double u2;
 };
 
+struct ShapeResult {
+    TopoDS_Shape shape;
+    bool isOk;
+    std::string error;
+    /// @brief Modified/Generated/IsDeleted of the operation, null if it does not record one.
+    Handle(BRepTools_History) history;
+};
+
 struct FaceCheckResult {
     int index;
     bool isValid;
@@ -225,3 +239,16 @@ EMSCRIPTEN_DECLARE_VAL_TYPE(ShellArray)
 EMSCRIPTEN_DECLARE_VAL_TYPE(ShapeArray)
 EMSCRIPTEN_DECLARE_VAL_TYPE(PointAndParameterArray)
 EMSCRIPTEN_DECLARE_VAL_TYPE(PntArray)
+EMSCRIPTEN_DECLARE_VAL_TYPE(ShapeNodeArray)
+
+struct ShapeNode {
+    std::optional<TopoDS_Shape> shape;
+    std::optional<std::string> color;
+    std::vector<ShapeNode> children;
+    std::string name;
+
+    ShapeNodeArray getChildren() const
+    {
+        return ShapeNodeArray(emscripten::val::array(children));
+    }
+};
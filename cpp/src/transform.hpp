@@ -0,0 +1,168 @@
+// Part of the Chili3d Project, under the LGPL-3.0 License.
+// See LICENSE-chili-wasm.text file in the project root for full license information.
+
+#pragma once
+
+#include <gp_Trsf.hxx>
+
+#include <cstddef>
+#include <cstring>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+/// @brief A gp_Trsf unpacked for the batched kernels below: the 3x4 matrix of points, row major, and
+/// the rotation of normals, which ignores the scale but flips with a negative one like gp_Dir does.
+struct AffineTransform {
+    double point[12];
+    float normal[9];
+    bool isIdentity;
+    bool keepsNormals;
+    bool flipsNormals;
+
+    explicit AffineTransform(const gp_Trsf& trsf)
+        : isIdentity(trsf.Form() == gp_Identity)
+        , keepsNormals(isIdentity || trsf.Form() == gp_Translation)
+        , flipsNormals(trsf.ScaleFactor() < 0)
+    {
+        auto rotation = trsf.HVectorialPart();
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 4; col++) {
+                point[row * 4 + col] = trsf.Value(row + 1, col + 1);
+            }
+            for (int col = 0; col < 3; col++) {
+                normal[row * 3 + col] = static_cast<float>(rotation.Value(row + 1, col + 1));
+            }
+        }
+    }
+};
+
+/// @brief Transforms count points stored as consecutive xyz doubles into xyz floats stride floats apart,
+/// 3 for a plain position buffer or more to write into interleaved vertices.
+inline void transformPointsScalar(const AffineTransform& t, const double* src, size_t count, float* dst,
+    size_t stride = 3)
+{
+    const double* m = t.point;
+    for (size_t i = 0; i < count; i++, src += 3, dst += stride) {
+        double x = src[0], y = src[1], z = src[2];
+        dst[0] = static_cast<float>(m[0] * x + m[1] * y + m[2] * z + m[3]);
+        dst[1] = static_cast<float>(m[4] * x + m[5] * y + m[6] * z + m[7]);
+        dst[2] = static_cast<float>(m[8] * x + m[9] * y + m[10] * z + m[11]);
+    }
+}
+
+/// @brief Transforms count normals stored as consecutive xyz floats, reversing them first if asked. The
+/// results are stride floats apart like in transformPointsScalar.
+inline void transformNormalsScalar(const AffineTransform& t, const float* src, size_t count, bool reverse, float* dst,
+    size_t stride = 3)
+{
+    const float* m = t.normal;
+    float sign = reverse != t.flipsNormals ? -1.0f : 1.0f;
+    for (size_t i = 0; i < count; i++, src += 3, dst += stride) {
+        float x = src[0] * sign, y = src[1] * sign, z = src[2] * sign;
+        dst[0] = m[0] * x + m[1] * y + m[2] * z;
+        dst[1] = m[3] * x + m[4] * y + m[5] * z;
+        dst[2] = m[6] * x + m[7] * y + m[8] * z;
+    }
+}
+
+#ifdef __wasm_simd128__
+
+/// @brief Two points per iteration in f64x2 lanes, so the result matches the scalar kernel bit for bit.
+inline void transformPointsSimd(const AffineTransform& t, const double* src, size_t count, float* dst,
+    size_t stride = 3)
+{
+    v128_t m[12];
+    for (int i = 0; i < 12; i++) {
+        m[i] = wasm_f64x2_splat(t.point[i]);
+    }
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2, src += 6, dst += 2 * stride) {
+        v128_t a = wasm_v128_load(src); // x0 y0
+        v128_t b = wasm_v128_load(src + 2); // z0 x1
+        v128_t c = wasm_v128_load(src + 4); // y1 z1
+        v128_t x = wasm_i64x2_shuffle(a, b, 0, 3);
+        v128_t y = wasm_i64x2_shuffle(a, c, 1, 2);
+        v128_t z = wasm_i64x2_shuffle(b, c, 0, 3);
+
+        v128_t r[3];
+        for (int row = 0; row < 3; row++) {
+            v128_t sum = wasm_f64x2_add(wasm_f64x2_mul(m[row * 4], x), wasm_f64x2_mul(m[row * 4 + 1], y));
+            sum = wasm_f64x2_add(sum, wasm_f64x2_mul(m[row * 4 + 2], z));
+            r[row] = wasm_f32x4_demote_f64x2_zero(wasm_f64x2_add(sum, m[row * 4 + 3]));
+        }
+
+        v128_t xy = wasm_i32x4_shuffle(r[0], r[1], 0, 4, 1, 5); // x0 y0 x1 y1
+        if (stride == 3) {
+            wasm_v128_store(dst, wasm_i32x4_shuffle(xy, r[2], 0, 1, 4, 2)); // x0 y0 z0 x1
+            wasm_v128_store64_lane(dst + 4, wasm_i32x4_shuffle(r[1], r[2], 1, 5, 1, 5), 0); // y1 z1
+            continue;
+        }
+        wasm_v128_store64_lane(dst, xy, 0);
+        wasm_v128_store32_lane(dst + 2, r[2], 0);
+        wasm_v128_store64_lane(dst + stride, xy, 1);
+        wasm_v128_store32_lane(dst + stride + 2, r[2], 1);
+    }
+    transformPointsScalar(t, src, count - i, dst, stride);
+}
+
+inline void transformNormalsSimd(const AffineTransform& t, const float* src, size_t count, bool reverse, float* dst,
+    size_t stride = 3)
+{
+    const float* m = t.normal;
+    float sign = reverse != t.flipsNormals ? -1.0f : 1.0f;
+    v128_t c0 = wasm_f32x4_make(m[0] * sign, m[3] * sign, m[6] * sign, 0);
+    v128_t c1 = wasm_f32x4_make(m[1] * sign, m[4] * sign, m[7] * sign, 0);
+    v128_t c2 = wasm_f32x4_make(m[2] * sign, m[5] * sign, m[8] * sign, 0);
+    for (size_t i = 0; i < count; i++, src += 3, dst += stride) {
+        v128_t r = wasm_f32x4_add(wasm_f32x4_mul(c0, wasm_f32x4_splat(src[0])),
+            wasm_f32x4_mul(c1, wasm_f32x4_splat(src[1])));
+        r = wasm_f32x4_add(r, wasm_f32x4_mul(c2, wasm_f32x4_splat(src[2])));
+        wasm_v128_store64_lane(dst, r, 0);
+        wasm_v128_store32_lane(dst + 2, r, 2);
+    }
+}
+
+#endif
+
+inline void transformPoints(const AffineTransform& t, const double* src, size_t count, float* dst, size_t stride = 3)
+{
+    if (t.isIdentity) {
+        for (size_t i = 0; i < count; i++, src += 3, dst += stride) {
+            dst[0] = static_cast<float>(src[0]);
+            dst[1] = static_cast<float>(src[1]);
+            dst[2] = static_cast<float>(src[2]);
+        }
+        return;
+    }
+#ifdef __wasm_simd128__
+    transformPointsSimd(t, src, count, dst, stride);
+#else
+    transformPointsScalar(t, src, count, dst, stride);
+#endif
+}
+
+inline void transformNormals(const AffineTransform& t, const float* src, size_t count, bool reverse, float* dst,
+    size_t stride = 3)
+{
+    if (t.keepsNormals) {
+        if (!reverse && stride == 3) {
+            std::memcpy(dst, src, count * 3 * sizeof(float));
+            return;
+        }
+        float sign = reverse ? -1.0f : 1.0f;
+        for (size_t i = 0; i < count; i++, src += 3, dst += stride) {
+            dst[0] = sign * src[0];
+            dst[1] = sign * src[1];
+            dst[2] = sign * src[2];
+        }
+        return;
+    }
+#ifdef __wasm_simd128__
+    transformNormalsSimd(t, src, count, reverse, dst, stride);
+#else
+    transformNormalsScalar(t, src, count, reverse, dst, stride);
+#endif
+}
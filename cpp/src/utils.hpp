@@ -25,4 +25,12 @@ NCollection_List<TopoDS_Shape> shapeArrayToListOfShape(const ShapeArray& shapes)
 NCollection_Map<TopoDS_Shape, TopTools_ShapeMapHasher> shapeArrayToMapOfShape(const ShapeArray& shapes);
 
 double boundingBoxRatio(const TopoDS_Shape& shape, double linearDeflection, bool useTriangulation);
-std::optional<gp_Pnt2d> pointToFaceUV(const TopoDS_Face& face, gp_Pnt pnt, double tolerance);
\ No newline at end of file
+std::optional<gp_Pnt2d> pointToFaceUV(const TopoDS_Face& face, gp_Pnt pnt, double tolerance);
+
+/// @brief Wraps a wasm heap buffer as a JS typed array without copying.
+/// The view is detached when the heap grows, so JS must copy it before calling back into wasm.
+template <typename TArray, typename T>
+TArray typedArrayView(const std::vector<T>& data)
+{
+    return TArray(emscripten::val(emscripten::typed_memory_view(data.size(), data.data())));
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+// Part of the Chili3d Project, under the LGPL-3.0 License.
+// See LICENSE-chili-wasm.text file in the project root for full license information.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <vector>
+
+/// @brief Size of the simulated post-transform cache, larger than the FIFO of most GPUs so that the order
+/// also suits the bigger caches of newer ones.
+constexpr int VERTEX_CACHE_SIZE = 32;
+
+/// @brief Tom Forsyth's score: vertices of the last triangle rank a little below the rest of the cache so
+/// that strips do not stall, and vertices with few triangles left are boosted so they leave the cache.
+inline float vertexCacheScore(int cachePosition, uint32_t remaining)
+{
+    if (remaining == 0) {
+        return -1;
+    }
+    float score = 0;
+    if (cachePosition >= 0) {
+        score = cachePosition < 3
+            ? 0.75f
+            : std::pow(1.0f - static_cast<float>(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+}
+
+/// @brief Reorders the triangles of one index range in place with Forsyth's greedy algorithm. The indices
+/// must lie in [vertexStart, vertexStart + vertexCount).
+inline void optimizeVertexCache(uint32_t* index, size_t indexCount, uint32_t vertexStart, uint32_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        remaining[index[i] - vertexStart]++;
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(indexCount);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; i++) {
+        adjacency[fill[index[i] - vertexStart]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = vertexCacheScore(-1, remaining[v]);
+    }
+    auto triangleScore = [&](size_t t) {
+        return vertexScore[index[t * 3] - vertexStart] + vertexScore[index[t * 3 + 1] - vertexStart]
+            + vertexScore[index[t * 3 + 2] - vertexStart];
+    };
+
+    size_t best = 0;
+    float bestScore = -std::numeric_limits<float>::infinity();
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (triangleScore(t) > bestScore) {
+            best = t;
+            bestScore = triangleScore(t);
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> result;
+    result.reserve(indexCount);
+    std::vector<uint32_t> cache, nextCache;
+    size_t cursor = 0;
+    while (result.size() < indexCount) {
+        if (best == triangleCount) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        emitted[best] = true;
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = index[best * 3 + k] - vertexStart;
+            result.push_back(index[best * 3 + k]);
+            auto begin = adjacency.begin() + offsets[v];
+            auto end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, static_cast<uint32_t>(best)), end - 1);
+            remaining[v]--;
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+                nextCache.push_back(v);
+            }
+        }
+        for (auto v : cache) {
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+                nextCache.push_back(v);
+            }
+        }
+        cache.swap(nextCache);
+
+        for (size_t i = 0; i < cache.size(); i++) {
+            cachePosition[cache[i]] = i < VERTEX_CACHE_SIZE ? static_cast<int>(i) : -1;
+            vertexScore[cache[i]] = vertexCacheScore(cachePosition[cache[i]], remaining[cache[i]]);
+        }
+
+        best = triangleCount;
+        bestScore = -std::numeric_limits<float>::infinity();
+        for (auto v : cache) {
+            for (uint32_t i = offsets[v]; i < offsets[v] + remaining[v]; i++) {
+                float score = triangleScore(adjacency[i]);
+                if (score > bestScore) {
+                    best = adjacency[i];
+                    bestScore = score;
+                }
+            }
+        }
+        if (cache.size() > VERTEX_CACHE_SIZE) {
+            cache.resize(VERTEX_CACHE_SIZE);
+        }
+    }
+    std::copy(result.begin(), result.end(), index);
+}
+
+/// @brief Renumbers the vertices of one index range in the order the indices first use them, so the vertex
+/// fetch walks memory forward. Returns the new position of every vertex, relative to vertexStart.
+inline std::vector<uint32_t> optimizeVertexFetch(uint32_t* index, size_t indexCount, uint32_t vertexStart,
+    uint32_t vertexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, std::numeric_limits<uint32_t>::max());
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t v = index[i] - vertexStart;
+        if (remap[v] == std::numeric_limits<uint32_t>::max()) {
+            remap[v] = next++;
+        }
+        index[i] = remap[v] + vertexStart;
+    }
+    for (auto& v : remap) {
+        if (v == std::numeric_limits<uint32_t>::max()) {
+            v = next++;
+        }
+    }
+    return remap;
+}
+
+/// @brief Moves the vertices of an attribute buffer to the positions optimizeVertexFetch returned.
+template <typename T>
+void remapVertices(std::vector<T>& data, size_t components, uint32_t vertexStart, const std::vector<uint32_t>& remap)
+{
+    auto first = data.begin() + vertexStart * components;
+    std::vector<T> copy(first, first + remap.size() * components);
+    for (size_t v = 0; v < remap.size(); v++) {
+        std::copy_n(copy.begin() + v * components, components, first + remap[v] * components);
+    }
+}
+
+/// @brief Average cache miss ratio, vertex transforms per triangle, of a FIFO cache of cacheSize entries.
+/// 0.5 is the best a regular grid can reach, 3 means no reuse at all.
+inline double averageCacheMissRatio(const uint32_t* index, size_t indexCount, size_t cacheSize)
+{
+    if (indexCount < 3) {
+        return 0;
+    }
+    std::deque<uint32_t> fifo;
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (std::find(fifo.begin(), fifo.end(), index[i]) != fifo.end()) {
+            continue;
+        }
+        misses++;
+        fifo.push_back(index[i]);
+        if (fifo.size() > cacheSize) {
+            fifo.pop_front();
+        }
+    }
+    return static_cast<double>(misses) / (indexCount / 3);
+}
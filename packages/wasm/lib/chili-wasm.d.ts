@@ -29,6 +29,7 @@ export interface ShapeResult extends ClassHandle {
   get error(): string;
   set error(value: EmbindString);
   shape: TopoDS_Shape;
+  history: Handle_BRepTools_History;
 }
 
 export interface ShapeFactory extends ClassHandle {
@@ -50,23 +51,118 @@ export interface Surface extends ClassHandle {
 export interface BrepHelps extends ClassHandle {
 }
 
+export interface Parallel extends ClassHandle {
+}
+
+export interface VertexLayoutValue<T extends number> {
+  value: T;
+}
+export type VertexLayout = VertexLayoutValue<0>|VertexLayoutValue<1>|VertexLayoutValue<2>;
+
 export interface Mesher extends ClassHandle {
+  compactIndex: boolean;
+  indexedEdges: boolean;
+  vertexLayout: VertexLayout;
+  optimizeVertexCache: boolean;
+  localSpace: boolean;
+  readonly decimated: boolean;
+  readonly changedFaces: number;
+  mesh(): MeshData;
+  meshDecimated(_0: number, _1: number): MeshData;
+  meshInstanced(): InstancedMeshData;
+  meshLevels(_0: Array<number>): LodMeshData;
+  meshQuantized(): QuantizedMeshData;
+  release(): void;
+  locationMatrix(): Float32Array;
+  edgesMeshPosition(): Float32Array;
+}
+
+export interface EdgeBatchMesher extends ClassHandle {
+  mesh(): EdgeMeshData;
+  shapes(): Uint32Array;
+  release(): void;
+}
+
+export interface MeshStream extends ClassHandle {
+  readonly faceCount: number;
+  readonly sentFaces: number;
+  next(): MeshData | undefined;
+  release(): void;
+}
+
+export interface MeshJob extends ClassHandle {
+  readonly progress: number;
+  readonly finished: boolean;
+  readonly cancelled: boolean;
+  step(_0: number): boolean;
+  cancel(): void;
+  mesh(): MeshData;
+  release(): void;
+}
+
+export interface SceneMesher extends ClassHandle {
+  readonly budgetMet: boolean;
+  mesh(_0: number): MeshData;
+  estimatedTriangles(): Array<number>;
+  actualTriangles(): Array<number>;
+  release(): void;
+}
+
+export interface AssemblyMesher extends ClassHandle {
   mesh(): MeshData;
-  edgesMeshPosition(): Array<number>;
+  nodes(): Uint32Array;
+  mergeByColor(): ColorBatchData;
+  release(): void;
+}
+
+export type MeshRayHit = {
+  face: number,
+  triangle: number,
+  u: number,
+  v: number,
+  distance: number,
+  point: Vector3
+};
+
+export type MeshEdgeHit = {
+  edge: number,
+  segment: number,
+  parameter: number,
+  distance: number,
+  point: Vector3
+};
+
+export interface MeshBvh extends ClassHandle {
+  readonly triangleCount: number;
+  readonly segmentCount: number;
+  raycast(_0: Vector3, _1: Vector3): MeshRayHit | undefined;
+  nearestEdge(_0: Vector3, _1: Vector3, _2: number, _3: number): MeshEdgeHit | undefined;
+  selectFaces(_0: Array<number>, _1: boolean): Array<number>;
+  selectEdges(_0: Array<number>, _1: boolean): Array<number>;
+  release(): void;
+}
+
+export interface MeshCache extends ClassHandle {
 }
 
 export interface EdgeMeshData extends ClassHandle {
-  position: Array<number>;
-  group: Array<number>;
+  readonly position: Float32Array;
+  readonly index: Uint32Array;
+  readonly group: Uint32Array;
   edges: Array<TopoDS_Edge>;
 }
 
 export interface FaceMeshData extends ClassHandle {
-  position: Array<number>;
-  normal: Array<number>;
-  uv: Array<number>;
-  index: Array<number>;
-  group: Array<number>;
+  readonly position: Float32Array;
+  readonly normal: Float32Array;
+  readonly uv: Float32Array;
+  readonly index: Uint32Array;
+  readonly group: Uint32Array;
+  readonly index16: Uint16Array;
+  readonly index32: Uint32Array;
+  readonly indexGroup: Uint32Array;
+  readonly vertices: Uint8Array;
+  readonly vertexStride: number;
   faces: Array<TopoDS_Face>;
 }
 
@@ -75,6 +171,50 @@ export interface MeshData extends ClassHandle {
   faceMeshData: FaceMeshData;
 }
 
+export interface InstancedMeshData extends ClassHandle {
+  edgeMeshData: EdgeMeshData;
+  faceMeshData: FaceMeshData;
+  prototypes: Array<TopoDS_Shape>;
+  readonly meshes: Uint32Array;
+  readonly instanceMesh: Uint32Array;
+  readonly instanceMatrix: Float32Array;
+}
+
+export interface QuantizedFaceMeshData extends ClassHandle {
+  faces: Array<TopoDS_Face>;
+  readonly position: Uint16Array;
+  readonly normal: Int8Array;
+  readonly uv: Uint16Array;
+  readonly index: Uint32Array;
+  readonly group: Uint32Array;
+  readonly positionOffset: Float32Array;
+  readonly positionScale: Float32Array;
+  readonly index16: Uint16Array;
+  readonly index32: Uint32Array;
+  readonly indexGroup: Uint32Array;
+}
+
+export interface QuantizedMeshData extends ClassHandle {
+  edgeMeshData: EdgeMeshData;
+  faceMeshData: QuantizedFaceMeshData;
+}
+
+export interface ColorBatchData extends ClassHandle {
+  faceMeshData: FaceMeshData;
+  readonly batches: Uint32Array;
+  readonly faceNodes: Uint32Array;
+}
+
+export interface LodMeshData extends ClassHandle {
+  faces: Array<TopoDS_Face>;
+  deflections: Array<number>;
+  readonly position: Float32Array;
+  readonly normal: Float32Array;
+  readonly uv: Float32Array;
+  index(_0: number): Uint32Array;
+  group(_0: number): Uint32Array;
+}
+
 export interface GeomAbs_ShapeValue<T extends number> {
   value: T;
 }
@@ -335,6 +475,12 @@ export interface Geom_SurfaceOfRevolution extends Geom_SweptSurface {
   referencePlane(): gp_Ax2;
 }
 
+export interface BRepTools_History extends Standard_Transient {
+  hasModified(): boolean;
+  hasGenerated(): boolean;
+  hasRemoved(): boolean;
+}
+
 export interface Handle_Standard_Transient extends ClassHandle {
   get(): Standard_Transient | null;
   isNull(): boolean;
@@ -365,6 +511,11 @@ export interface Handle_Geom_Surface extends ClassHandle {
   isNull(): boolean;
 }
 
+export interface Handle_BRepTools_History extends ClassHandle {
+  get(): BRepTools_History | null;
+  isNull(): boolean;
+}
+
 export interface gp_Pnt extends ClassHandle {
   readonly x: number;
   readonly y: number;
@@ -492,6 +643,22 @@ export interface Face extends ClassHandle {
 export interface Solid extends ClassHandle {
 }
 
+export type ShapeRayHit = {
+  face: TopoDS_Face,
+  faceIndex: number,
+  u: number,
+  v: number,
+  parameter: number,
+  point: Vector3
+};
+
+export interface ShapeRayCaster extends ClassHandle {
+  readonly faceCount: number;
+  intersectRay(_0: Vector3, _1: Vector3): ShapeRayHit | undefined;
+  intersectLine(_0: Vector3, _1: Vector3): ShapeRayHit | undefined;
+  release(): void;
+}
+
 export interface ShapeVector extends ClassHandle, Iterable<TopoDS_Shape> {
   push_back(_0: TopoDS_Shape): void;
   resize(_0: number, _1: TopoDS_Shape): void;
@@ -661,12 +828,53 @@ interface EmbindModule {
     hasContinue(_0: TopoDS_Edge, _1: TopoDS_Face, _2: TopoDS_Face): boolean;
     continuity(_0: TopoDS_Edge, _1: TopoDS_Face, _2: TopoDS_Face): GeomAbs_Shape;
   };
+  Parallel: {
+    isThreaded(): boolean;
+    logicalProcessors(): number;
+    threadCount(): number;
+    setThreadCount(_0: number): void;
+  };
+  VertexLayout: {Separate: VertexLayoutValue<0>, Interleaved: VertexLayoutValue<1>, Packed: VertexLayoutValue<2>};
   Mesher: {
     new(_0: TopoDS_Shape, _1: number, _2: boolean): Mesher;
+    new(_0: TopoDS_Shape, _1: number, _2: boolean, _3: number): Mesher;
+    new(_0: TopoDS_Shape, _1: number, _2: boolean, _3: TopoDS_Shape, _4: Handle_BRepTools_History): Mesher;
+  };
+  EdgeBatchMesher: {
+    new(_0: Array<TopoDS_Shape>, _1: number, _2: boolean): EdgeBatchMesher;
+  };
+  MeshStream: {
+    new(_0: TopoDS_Shape, _1: number, _2: boolean, _3: number): MeshStream;
+  };
+  MeshJob: {
+    new(_0: TopoDS_Shape, _1: number, _2: boolean): MeshJob;
+  };
+  AssemblyMesher: {
+    new(_0: ShapeNode, _1: number, _2: boolean): AssemblyMesher;
+    fromShapes(_0: Array<TopoDS_Shape>, _1: number, _2: boolean): AssemblyMesher;
+  };
+  SceneMesher: {
+    new(_0: Array<TopoDS_Shape>, _1: number, _2: boolean, _3: number): SceneMesher;
+    trianglesForBytes(_0: number): number;
+  };
+  MeshBvh: {
+    new(_0: FaceMeshData, _1: EdgeMeshData): MeshBvh;
+  };
+  MeshCache: {
+    hits(): number;
+    misses(): number;
+    size(): number;
+    setCapacity(_0: number): void;
+    clear(): void;
   };
   EdgeMeshData: {};
   FaceMeshData: {};
   MeshData: {};
+  InstancedMeshData: {};
+  QuantizedFaceMeshData: {};
+  QuantizedMeshData: {};
+  ColorBatchData: {};
+  LodMeshData: {};
   GeomAbs_Shape: {GeomAbs_C0: GeomAbs_ShapeValue<0>, GeomAbs_C1: GeomAbs_ShapeValue<2>, GeomAbs_C2: GeomAbs_ShapeValue<4>, GeomAbs_C3: GeomAbs_ShapeValue<5>, GeomAbs_CN: GeomAbs_ShapeValue<6>, GeomAbs_G1: GeomAbs_ShapeValue<1>, GeomAbs_G2: GeomAbs_ShapeValue<3>};
   GeomAbs_JoinType: {GeomAbs_Arc: GeomAbs_JoinTypeValue<0>, GeomAbs_Intersection: GeomAbs_JoinTypeValue<2>, GeomAbs_Tangent: GeomAbs_JoinTypeValue<1>};
   TopAbs_ShapeEnum: {TopAbs_VERTEX: TopAbs_ShapeEnumValue<7>, TopAbs_EDGE: TopAbs_ShapeEnumValue<6>, TopAbs_WIRE: TopAbs_ShapeEnumValue<5>, TopAbs_FACE: TopAbs_ShapeEnumValue<4>, TopAbs_SHELL: TopAbs_ShapeEnumValue<3>, TopAbs_SOLID: TopAbs_ShapeEnumValue<2>, TopAbs_COMPOUND: TopAbs_ShapeEnumValue<0>, TopAbs_COMPSOLID: TopAbs_ShapeEnumValue<1>, TopAbs_SHAPE: TopAbs_ShapeEnumValue<8>};
@@ -702,6 +910,7 @@ interface EmbindModule {
   Geom_ToroidalSurface: {};
   Geom_SurfaceOfLinearExtrusion: {};
   Geom_SurfaceOfRevolution: {};
+  BRepTools_History: {};
   Handle_Standard_Transient: {
     new(_0: Standard_Transient | null): Handle_Standard_Transient;
   };
@@ -720,6 +929,9 @@ interface EmbindModule {
   Handle_Geom_Surface: {
     new(_0: Geom_Surface | null): Handle_Geom_Surface;
   };
+  Handle_BRepTools_History: {
+    new(_0: BRepTools_History | null): Handle_BRepTools_History;
+  };
   gp_Pnt: {
     new(_0: number, _1: number, _2: number): gp_Pnt;
   };
@@ -788,7 +1000,7 @@ interface EmbindModule {
     findAncestor(_0: TopoDS_Shape, _1: TopoDS_Shape, _2: TopAbs_ShapeEnum): Array<TopoDS_Shape>;
     findSubShapes(_0: TopoDS_Shape, _1: TopAbs_ShapeEnum): Array<TopoDS_Shape>;
     getDirectSubShapes(_0: TopoDS_Shape): Array<TopoDS_Shape>;
-    splitShapes(_0: Array<TopoDS_Shape>, _1: Array<TopoDS_Shape>, _2: number): TopoDS_Shape;
+    splitShapes(_0: Array<TopoDS_Shape>, _1: Array<TopoDS_Shape>, _2: number): ShapeResult;
     removeFeature(_0: TopoDS_Shape, _1: Array<TopoDS_Shape>): TopoDS_Shape | undefined;
     removeFillet(_0: TopoDS_Shape, _1: Array<TopoDS_Shape>, _2: ShapeVector): TopoDS_Shape | undefined;
     removeSubShape(_0: TopoDS_Shape, _1: Array<TopoDS_Shape>): TopoDS_Shape;
@@ -827,6 +1039,9 @@ interface EmbindModule {
     volume(_0: TopoDS_Solid): number;
     containsPoint(_0: TopoDS_Shape, _1: Vector3, _2: boolean, _3: number): boolean;
   };
+  ShapeRayCaster: {
+    new(_0: TopoDS_Shape, _1: number): ShapeRayCaster;
+  };
   ShapeVector: {
     new(): ShapeVector;
   };
@@ -222,11 +222,11 @@ export class OccShape implements IShape {
 
     edgesMeshPosition(): EdgeMeshData {
         const occMesher = new wasm.Mesher(this.shape, 0.005, true);
-        const position = occMesher.edgesMeshPosition();
+        const position = occMesher.edgesMeshPosition().slice();
         occMesher.delete();
         return {
             lineType: "solid",
-            position: new Float32Array(position),
+            position,
             range: [],
             color: VisualConfig.defaultEdgeColor,
         };
@@ -333,7 +333,7 @@ export class OccShape implements IShape {
             }
             throw new Error("Unsupported type");
         });
-        return OccShape.wrap(wasm.Shape.splitShapes([this.shape], occShapes, tolerance));
+        return OccShape.wrap(wasm.Shape.splitShapes([this.shape], occShapes, tolerance).shape);
     }
 
     reserve(): void {
@@ -893,10 +893,11 @@ export class Mesher implements IShapeMeshData, IDisposable {
 
     private getEdgeRanges(data: OccEdgeMeshData): ShapeMeshRange[] {
         const result: ShapeMeshRange[] = [];
+        const group = data.group.slice();
         for (let i = 0; i < data.edges.length; i++) {
             result.push({
-                start: data.group[2 * i],
-                count: data.group[2 * i + 1],
+                start: group[2 * i],
+                count: group[2 * i + 1],
                 shape: new OccSubEdgeShape({
                     parent: this.shape,
                     shape: data.edges[i],
@@ -910,10 +911,11 @@ export class Mesher implements IShapeMeshData, IDisposable {
 
     private getFaceRanges(data: OccFaceMeshData): ShapeMeshRange[] {
         const result: ShapeMeshRange[] = [];
+        const group = data.group.slice();
         for (let i = 0; i < data.faces.length; i++) {
             result.push({
-                start: data.group[2 * i],
-                count: data.group[2 * i + 1],
+                start: group[2 * i],
+                count: group[2 * i + 1],
                 shape: new OccSubFaceShape({
                     parent: this.shape,
                     shape: data.faces[i],
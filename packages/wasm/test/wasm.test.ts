@@ -33,6 +33,585 @@ test("test edge mesh", () => {
     expect(mesh.edgeMeshData.group.length).toBe(24);
 });
 
+test("test indexed edge mesh", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const circle = wasm.ShapeFactory.circle(direction, location, 1).shape;
+    const mesher = new wasm.Mesher(circle, 0.1, true);
+    mesher.indexedEdges = true;
+    const mesh = mesher.mesh().edgeMeshData;
+    const pointCount = mesh.position.length / 3;
+    expect(mesh.index.length).toBe((pointCount - 1) * 2);
+    expect(Array.from(mesh.group)).toEqual([0, mesh.index.length]);
+});
+
+test("test edge batch mesh", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 1, 1).shape;
+    const circle = wasm.ShapeFactory.circle(direction, location, 1).shape;
+    const mesher = new wasm.EdgeBatchMesher([box, circle], 0.1, true);
+    const mesh = mesher.mesh();
+
+    expect(Array.from(mesher.shapes())).toEqual([0, 12, 12, 1]);
+    expect(mesh.edges.length).toBe(13);
+    expect(mesh.group.length).toBe(26);
+    mesher.release();
+    expect(mesher.shapes().length).toBe(0);
+});
+
+test("test mesh release", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 1, 1).shape;
+    const mesher = new wasm.Mesher(box, 0.1, true);
+    const mesh = mesher.mesh();
+    expect(mesh.faceMeshData.position).toBeInstanceOf(Float32Array);
+    expect(mesh.faceMeshData.index).toBeInstanceOf(Uint32Array);
+
+    mesher.release();
+    expect(mesh.faceMeshData.position.length).toBe(0);
+    expect(mesh.edgeMeshData.position.length).toBe(0);
+    mesher.delete();
+});
+
+test("test instanced mesh", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 1, 1).shape;
+    const assembly = wasm.ShapeFactory.combine([box, box, box]).shape;
+    const mesher = new wasm.Mesher(assembly, 0.1, true);
+    const mesh = mesher.meshInstanced();
+
+    expect(mesh.prototypes.length).toBe(1);
+    expect(mesh.meshes).toEqual(new Uint32Array([0, 6, 0, 12]));
+    expect(mesh.instanceMesh).toEqual(new Uint32Array([0, 0, 0]));
+    expect(mesh.instanceMatrix.length).toBe(48);
+    expect(mesh.faceMeshData.position.length).toBe(72);
+    mesher.delete();
+});
+
+test("test compact index", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const mesher = new wasm.Mesher(box, 0.1, true);
+    mesher.compactIndex = true;
+    const mesh = mesher.mesh().faceMeshData;
+
+    expect(mesh.index.length).toBe(0);
+    expect(mesh.index16.length).toBe(36);
+    expect(mesh.index32.length).toBe(0);
+    expect(Array.from(mesh.indexGroup.slice(4, 8))).toEqual([4, 4, 6, 6]);
+});
+
+test("test planar normals", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 2, 2, 2).shape;
+    const mesh = new wasm.Mesher(box, 0.1, true).mesh().faceMeshData;
+
+    for (let i = 0; i < mesh.normal.length; i += 3) {
+        let outward = 0;
+        for (let j = 0; j < 3; j++) {
+            outward += mesh.normal[i + j] * (mesh.position[i + j] - 1);
+        }
+        expect(outward).toBeCloseTo(1);
+    }
+});
+
+test("test mesh stream", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const stream = new wasm.MeshStream(box, 0.1, true, 4);
+
+    let faces = 0;
+    let edges = 0;
+    for (let chunk = stream.next(); chunk; chunk = stream.next()) {
+        faces += chunk.faceMeshData.faces.length;
+        edges += chunk.edgeMeshData.edges.length;
+    }
+    expect(faces).toBe(6);
+    expect(edges).toBe(12);
+    expect(stream.sentFaces).toBe(stream.faceCount);
+    stream.release();
+});
+
+test("test mesh job", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const job = new wasm.MeshJob(box, 0.1, true);
+    while (!job.step(8)) {}
+
+    expect(job.progress).toBe(1);
+    expect(job.mesh().faceMeshData.faces.length).toBe(6);
+    job.release();
+
+    const cancelled = new wasm.MeshJob(box, 0.1, true);
+    cancelled.cancel();
+    expect(cancelled.step(8)).toBe(true);
+    expect(cancelled.mesh().faceMeshData.faces.length).toBe(0);
+});
+
+test("test mesh stream matches mesh", () => {
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const makeShape = () =>
+        wasm.ShapeFactory.booleanFuse(
+            [wasm.ShapeFactory.box({ location: { x: 0, y: 0, z: 0 }, direction, xDirection }, 20, 20, 20).shape],
+            [wasm.ShapeFactory.cylinder(direction, { x: 10, y: 10, z: 20 }, 0.2, 1).shape],
+        ).shape;
+    const triangles = (data: { faceMeshData: { index: Uint32Array } }) => data.faceMeshData.index.length / 3;
+
+    const mesher = new wasm.Mesher(makeShape(), 0.1, true);
+    const expected = triangles(mesher.mesh());
+    mesher.delete();
+
+    const stream = new wasm.MeshStream(makeShape(), 0.1, true, 4);
+    let streamed = 0;
+    for (let chunk = stream.next(); chunk; chunk = stream.next()) {
+        streamed += triangles(chunk);
+    }
+    stream.release();
+    expect(streamed).toBeGreaterThan(expected * 0.9);
+    expect(streamed).toBeLessThan(expected * 1.1);
+
+    const job = new wasm.MeshJob(makeShape(), 0.1, true);
+    while (!job.step(8)) {}
+    const jobTriangles = triangles(job.mesh());
+    job.release();
+    expect(jobTriangles).toBeGreaterThan(expected * 0.9);
+    expect(jobTriangles).toBeLessThan(expected * 1.1);
+});
+
+test("test triangle budget", () => {
+    const sphere = wasm.ShapeFactory.sphere({ x: 0, y: 0, z: 0 }, 10).shape;
+    const fine = new wasm.Mesher(sphere, 0.001, true).mesh();
+    const budget = new wasm.Mesher(sphere, 0.001, true, 500).mesh();
+
+    expect(budget.faceMeshData.index.length).toBeLessThan(fine.faceMeshData.index.length);
+});
+
+test("test scene mesher", () => {
+    const center = { x: 0, y: 0, z: 0 };
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const box = wasm.ShapeFactory.box({ location, direction, xDirection }, 1, 2, 3).shape;
+    const sphere = wasm.ShapeFactory.sphere(center, 10).shape;
+    const fine = new wasm.Mesher(sphere, 0.001, true);
+    const fineTriangles = fine.mesh().faceMeshData.index.length / 3;
+    fine.delete();
+    const scene = new wasm.SceneMesher([box, sphere], 0.001, true, 2000);
+
+    const actual = scene.actualTriangles();
+    expect(scene.budgetMet).toBe(true);
+    expect(scene.estimatedTriangles().length).toBe(2);
+    expect(actual[0]).toBe(12);
+    expect(actual[1]).toBeLessThan(fineTriangles);
+    expect(scene.mesh(1).faceMeshData.index.length / 3).toBe(actual[1]);
+    expect(scene.mesh(2).faceMeshData.faces.length).toBe(0);
+    scene.release();
+
+    const tight = new wasm.SceneMesher([box, sphere], 0.001, true, 1);
+    expect(tight.budgetMet).toBe(false);
+    tight.release();
+});
+
+test("test assembly mesh", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box1 = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const box2 = wasm.ShapeFactory.box(ax3, 3, 2, 1).shape;
+    const mesher = wasm.AssemblyMesher.fromShapes([box1, box2], 0.1, true);
+    const mesh = mesher.mesh();
+    const nodes = Array.from(mesher.nodes());
+
+    expect(nodes.length).toBe(20);
+    expect(nodes.slice(0, 10)).toEqual([1, 0, 24, 0, 36, 0, 6, 0, 12, 0xffffffff]);
+    expect(nodes.slice(10, 20)).toEqual([2, 24, 24, 36, 36, 6, 6, 12, 12, 0xffffffff]);
+    expect(mesh.faceMeshData.faces.length).toBe(12);
+
+    const merged = mesher.mergeByColor();
+    expect(Array.from(merged.batches)).toEqual([0xffffffff, 0, 48, 0, 72]);
+    expect(Array.from(merged.faceNodes)).toEqual([1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2]);
+    mesher.release();
+});
+
+test("test face groups are contiguous and ordered", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const box = wasm.ShapeFactory.box({ location, direction, xDirection }, 10, 10, 2).shape;
+    const tools = [2, 5, 8].map((x) => wasm.ShapeFactory.cylinder(direction, { x, y: 5, z: -1 }, 1, 4).shape);
+    const shape = wasm.ShapeFactory.booleanCut([box], tools).shape;
+    const mesher = new wasm.Mesher(shape, 0.1, true);
+    const mesh = mesher.mesh().faceMeshData;
+    const faces = wasm.Shape.findSubShapes(shape, wasm.TopAbs_ShapeEnum.TopAbs_FACE);
+    expect(faces.length).toBeGreaterThan(6);
+    expect(mesh.faces.length).toBe(faces.length);
+    expect(mesh.group.length).toBe(faces.length * 2);
+
+    let indexEnd = 0;
+    let vertexEnd = 0;
+    mesh.faces.forEach((face, i) => {
+        expect(face.isEqual(faces[i])).toBe(true);
+        const start = mesh.group[i * 2];
+        const index = Array.from(mesh.index.slice(start, start + mesh.group[i * 2 + 1]));
+        expect(start).toBe(indexEnd);
+        expect(Math.min(...index)).toBe(vertexEnd);
+        indexEnd = start + index.length;
+        vertexEnd = Math.max(...index) + 1;
+    });
+    expect(indexEnd).toBe(mesh.index.length);
+    expect(vertexEnd * 3).toBe(mesh.position.length);
+    mesher.delete();
+});
+
+test("test assembly mesher meshes small leaves like Mesher", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 100, 100, 100).shape;
+    const sphere = wasm.ShapeFactory.sphere(location, 1).shape;
+    const mesher = wasm.AssemblyMesher.fromShapes([box, sphere], 0.1, true);
+    mesher.mesh();
+    const nodes = Array.from(mesher.nodes());
+
+    const alone = new wasm.Mesher(wasm.ShapeFactory.sphere(location, 1).shape, 0.1, true);
+    const expected = alone.mesh().faceMeshData.index.length;
+    expect(nodes[10]).toBe(2);
+    expect(nodes[14]).toBe(expected);
+    alone.delete();
+    mesher.release();
+});
+
+test("test interleaved vertices", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const mesher = new wasm.Mesher(box, 0.1, true);
+    mesher.vertexLayout = wasm.VertexLayout.Interleaved;
+    const mesh = mesher.mesh().faceMeshData;
+
+    expect(mesh.position.length).toBe(0);
+    expect(mesh.vertexStride).toBe(32);
+    expect(mesh.vertices.byteLength).toBe(24 * 32);
+    const separate = new wasm.Mesher(box, 0.1, true);
+    const expected = separate.mesh().faceMeshData;
+    const floats = new Float32Array(mesh.vertices.buffer, mesh.vertices.byteOffset, mesh.vertices.byteLength / 4);
+    for (let i = 0; i < 24; i++) {
+        for (let k = 0; k < 3; k++) {
+            expect(floats[i * 8 + k]).toBe(expected.position[i * 3 + k]);
+            expect(floats[i * 8 + 3 + k]).toBe(expected.normal[i * 3 + k]);
+        }
+        expect(floats[i * 8 + 6]).toBe(expected.uv[i * 2]);
+        expect(floats[i * 8 + 7]).toBe(expected.uv[i * 2 + 1]);
+    }
+    separate.delete();
+
+    mesher.vertexLayout = wasm.VertexLayout.Packed;
+    const packed = mesher.mesh().faceMeshData;
+    expect(packed.vertexStride).toBe(20);
+    expect(packed.vertices.byteLength).toBe(24 * 20);
+});
+
+test("test optimize vertex cache", () => {
+    const center = { x: 0, y: 0, z: 0 };
+    const sphere = wasm.ShapeFactory.sphere(center, 10).shape;
+    const mesher = new wasm.Mesher(sphere, 0.01, true);
+    mesher.optimizeVertexCache = true;
+    const mesh = mesher.mesh().faceMeshData;
+    const index = Array.from(mesh.index);
+
+    let next = 0;
+    for (const i of index) {
+        expect(i).toBeLessThanOrEqual(next);
+        next = Math.max(next, i + 1);
+    }
+    expect(mesh.position.length / 3).toBeGreaterThanOrEqual(next);
+});
+
+test("test decimated mesh", () => {
+    const center = { x: 0, y: 0, z: 0 };
+    const sphere = wasm.ShapeFactory.sphere(center, 10).shape;
+    const mesher = new wasm.Mesher(sphere, 0.01, true);
+    const full = mesher.mesh().faceMeshData.index.length;
+    const decimated = mesher.meshDecimated(0.25, 0);
+
+    expect(mesher.decimated).toBe(true);
+    expect(decimated.faceMeshData.index.length).toBeLessThan(full);
+    expect(decimated.faceMeshData.group[1]).toBe(decimated.faceMeshData.index.length);
+    expect(decimated.edgeMeshData.edges.length).toBe(3);
+});
+
+test("test decimated mesh keeps edge nodes", () => {
+    const direction = { x: 0, y: 0, z: 1 };
+    const cylinder = wasm.ShapeFactory.cylinder(direction, { x: 0, y: 0, z: 0 }, 10, 20).shape;
+    const mesher = new wasm.Mesher(cylinder, 0.01, true);
+    const decimated = mesher.meshDecimated(0.1, 0);
+    expect(mesher.decimated).toBe(true);
+
+    const position = decimated.faceMeshData.position;
+    const nodes = new Set<string>();
+    for (let i = 0; i < position.length; i += 3) {
+        nodes.add(`${position[i]},${position[i + 1]},${position[i + 2]}`);
+    }
+    const edges = decimated.edgeMeshData.position;
+    expect(edges.length).toBeGreaterThan(0);
+    for (let i = 0; i < edges.length; i += 3) {
+        expect(nodes.has(`${edges[i]},${edges[i + 1]},${edges[i + 2]}`)).toBe(true);
+    }
+    mesher.delete();
+});
+
+test("test local space mesh", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const trsf = new wasm.gp_Trsf();
+    trsf.setValues(1, 0, 0, 10, 0, 1, 0, 20, 0, 0, 1, 30);
+    const moved = box.located(new wasm.TopLoc_Location(trsf), false);
+
+    const mesher = new wasm.Mesher(moved, 0.1, true);
+    mesher.localSpace = true;
+    const mesh = mesher.mesh();
+    const local = Array.from(mesh.faceMeshData.position);
+    const origin = Array.from(new wasm.Mesher(box, 0.1, true).mesh().faceMeshData.position);
+    expect(local).toEqual(origin);
+    expect(Array.from(mesher.locationMatrix()).slice(12)).toEqual([10, 20, 30, 1]);
+
+    const movedFaces = wasm.Shape.findSubShapes(moved, wasm.TopAbs_ShapeEnum.TopAbs_FACE);
+    for (const face of mesh.faceMeshData.faces) {
+        expect(movedFaces.some((x) => x.isSame(face))).toBe(true);
+    }
+    const movedEdges = wasm.Shape.findSubShapes(moved, wasm.TopAbs_ShapeEnum.TopAbs_EDGE);
+    for (const edge of mesh.edgeMeshData.edges) {
+        expect(movedEdges.some((x) => x.isSame(edge))).toBe(true);
+    }
+
+    const s = Math.SQRT1_2;
+    const rotation = new wasm.gp_Trsf();
+    rotation.setValues(s, -s, 0, 0, s, s, 0, 0, 0, 0, 1, 0);
+    const rotatedBox = box.located(new wasm.TopLoc_Location(rotation), false);
+    wasm.MeshCache.setCapacity(1024 * 1024);
+    const meshLocal = (shape: typeof moved) => {
+        const placed = new wasm.Mesher(shape, 0.1, true);
+        placed.localSpace = true;
+        const position = Array.from(placed.mesh().faceMeshData.position);
+        placed.delete();
+        return position;
+    };
+    const hits = wasm.MeshCache.hits();
+    const misses = wasm.MeshCache.misses();
+    expect(meshLocal(moved)).toEqual(local);
+    expect(wasm.MeshCache.misses()).toBe(misses + 1);
+    expect(meshLocal(moved)).toEqual(local);
+    expect(meshLocal(rotatedBox)).toEqual(local);
+    expect(wasm.MeshCache.hits()).toBe(hits + 2);
+    expect(wasm.MeshCache.misses()).toBe(misses + 1);
+
+    wasm.MeshCache.setCapacity(0);
+    wasm.MeshCache.clear();
+});
+
+test("test mesh bvh", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const mesh = new wasm.Mesher(box, 0.1, true).mesh();
+    const bvh = new wasm.MeshBvh(mesh.faceMeshData, mesh.edgeMeshData);
+    expect(bvh.triangleCount).toBe(12);
+
+    const hit = bvh.raycast({ x: 0.5, y: 1, z: 10 }, { x: 0, y: 0, z: -1 });
+    expect(hit?.distance).toBeCloseTo(7);
+    expect(hit?.point.z).toBeCloseTo(3);
+    expect(bvh.raycast({ x: 5, y: 1, z: 10 }, { x: 0, y: 0, z: -1 })).toBeUndefined();
+
+    const edge = bvh.nearestEdge({ x: 0.01, y: 1, z: 10 }, { x: 0, y: 0, z: -1 }, 0.05, 0);
+    expect(edge?.distance).toBeCloseTo(0.01);
+    expect(bvh.nearestEdge({ x: 0.5, y: 1, z: 10 }, { x: 0, y: 0, z: -1 }, 0.05, 0)).toBeUndefined();
+
+    const around = [1, 0, 0, 1, -1, 0, 0, 2, 0, 1, 0, 1, 0, -1, 0, 3, 0, 0, 1, 1, 0, 0, -1, 4];
+    expect(bvh.selectFaces(around, true).length).toBe(6);
+    const top = [1, 0, 0, 1, -1, 0, 0, 2, 0, 1, 0, 1, 0, -1, 0, 3, 0, 0, 1, -2.5, 0, 0, -1, 4];
+    expect(bvh.selectFaces(top, false).length).toBe(5);
+    expect(bvh.selectFaces(top, true).length).toBe(1);
+    bvh.release();
+});
+
+test("test shape ray caster", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const caster = new wasm.ShapeRayCaster(box, 1e-7);
+    expect(caster.faceCount).toBe(6);
+
+    const hit = caster.intersectRay({ x: 0.5, y: 1, z: 10 }, { x: 0, y: 0, z: -1 });
+    expect(hit?.parameter).toBeCloseTo(7);
+    expect(hit?.point.z).toBeCloseTo(3);
+    const inside = caster.intersectRay({ x: 0.5, y: 1, z: 1 }, { x: 1, y: 0, z: 0 });
+    expect(inside?.point.x).toBeCloseTo(1);
+    expect(caster.intersectRay({ x: 0.5, y: 1, z: 10 }, { x: 0, y: 0, z: 1 })).toBeUndefined();
+    const behind = caster.intersectLine({ x: 0.5, y: 1, z: 10 }, { x: 0, y: 0, z: 1 });
+    expect(behind?.parameter).toBeCloseTo(-10);
+    expect(behind?.point.z).toBeCloseTo(0);
+    caster.release();
+});
+
+test("test quantized mesh", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 2, 3).shape;
+    const mesher = new wasm.Mesher(box, 0.1, true);
+    const mesh = mesher.meshQuantized().faceMeshData;
+
+    expect(mesh.position).toBeInstanceOf(Uint16Array);
+    expect(mesh.position.length).toBe(72);
+    expect(mesh.normal.length).toBe(48);
+    expect(mesh.uv.length).toBe(48);
+    expect(mesh.index.length).toBe(36);
+    expect(mesh.positionOffset.length).toBe(18);
+    const offset = mesh.positionOffset;
+    const scale = mesh.positionScale;
+    for (let i = 0; i < 4; i++) {
+        expect(offset[0] + scale[0] * mesh.position[i * 3]).toBeCloseTo(0, 3);
+    }
+});
+
+test("test mesh levels", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const box = wasm.ShapeFactory.box(ax3, 1, 1, 1).shape;
+    const mesher = new wasm.Mesher(box, 0.1, true);
+    const levels = mesher.meshLevels([0.01, 0.1]);
+
+    expect(levels.deflections).toEqual([0.1, 0.01]);
+    expect(levels.faces.length).toBe(6);
+    expect(levels.position.length).toBe(72);
+    expect(levels.index(0)).toEqual(levels.index(1));
+    expect(levels.group(1).length).toBe(12);
+    expect(levels.index(2).length).toBe(0);
+});
+
+test("test mesh cache", () => {
+    const location = { x: 0, y: 0, z: 0 };
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const ax3 = { location, direction, xDirection };
+    const result = wasm.ShapeFactory.box(ax3, 1, 1, 1);
+    const box = result.shape;
+    wasm.MeshCache.setCapacity(1024 * 1024);
+
+    const mesher1 = new wasm.Mesher(box, 0.1, true);
+    const position1 = mesher1.mesh().faceMeshData.position.slice();
+    mesher1.delete();
+    const mesher2 = new wasm.Mesher(box, 0.1, true);
+    const position2 = mesher2.mesh().faceMeshData.position.slice();
+    mesher2.delete();
+    const mesher3 = new wasm.Mesher(box, 0.1, true);
+    mesher3.localSpace = true;
+    mesher3.meshQuantized();
+    mesher3.delete();
+
+    expect(wasm.MeshCache.misses()).toBe(1);
+    expect(wasm.MeshCache.hits()).toBe(1);
+    expect(position2).toEqual(position1);
+    expect(wasm.MeshCache.size()).toBeGreaterThan(0);
+
+    box.delete();
+    result.delete();
+    expect(wasm.MeshCache.size()).toBe(0);
+
+    wasm.MeshCache.setCapacity(0);
+    wasm.MeshCache.clear();
+    expect(wasm.MeshCache.size()).toBe(0);
+});
+
+test("test incremental mesh", () => {
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const box = wasm.ShapeFactory.box({ location: { x: 0, y: 0, z: 0 }, direction, xDirection }, 1, 1, 1).shape;
+    const tool = wasm.ShapeFactory.box({ location: { x: 0.5, y: 0.5, z: 0.5 }, direction, xDirection }, 1, 1, 1).shape;
+    const faceTriangles = (mesh: { position: Float32Array; index: Uint32Array; group: Uint32Array }, i: number) => {
+        const start = mesh.group[i * 2];
+        const index = Array.from(mesh.index.slice(start, start + mesh.group[i * 2 + 1]));
+        return index.flatMap((v) => Array.from(mesh.position.slice(v * 3, v * 3 + 3)));
+    };
+    const sourceMesher = new wasm.Mesher(box, 0.1, true);
+    const sourceMesh = sourceMesher.mesh().faceMeshData;
+    const sourceFaces = sourceMesh.faces.map((face, i) => ({ face, triangles: faceTriangles(sourceMesh, i) }));
+    sourceMesher.delete();
+
+    const result = wasm.ShapeFactory.booleanCut([box], [tool]);
+    expect(result.history.isNull()).toBe(false);
+    const mesher = new wasm.Mesher(result.shape, 0.1, true, box, result.history);
+    const mesh = mesher.mesh().faceMeshData;
+    expect(mesh.faces.length).toBe(9);
+    expect(mesh.group.length).toBe(18);
+    expect(mesher.changedFaces).toBe(6);
+
+    let untouched = 0;
+    mesh.faces.forEach((face, i) => {
+        const source = sourceFaces.find((x) => x.face.isSame(face));
+        if (source) {
+            expect(faceTriangles(mesh, i)).toEqual(source.triangles);
+            untouched++;
+        }
+    });
+    expect(untouched).toBe(3);
+    mesher.delete();
+});
+
+test("test split shapes history", () => {
+    const direction = { x: 0, y: 0, z: 1 };
+    const xDirection = { x: 1, y: 0, z: 0 };
+    const box = wasm.ShapeFactory.box({ location: { x: 0, y: 0, z: 0 }, direction, xDirection }, 1, 1, 1).shape;
+    const tool = wasm.ShapeFactory.box({ location: { x: 0.5, y: 0.5, z: 0.5 }, direction, xDirection }, 1, 1, 1).shape;
+    new wasm.Mesher(box, 0.1, true).delete();
+
+    const result = wasm.Shape.splitShapes([box], [tool], 1e-5);
+    expect(result.isOk).toBe(true);
+    expect(result.history.isNull()).toBe(false);
+    const mesher = new wasm.Mesher(result.shape, 0.1, true, box, result.history);
+    const faces = wasm.Shape.findSubShapes(result.shape, wasm.TopAbs_ShapeEnum.TopAbs_FACE);
+    expect(mesher.changedFaces).toBeGreaterThan(0);
+    expect(mesher.changedFaces).toBeLessThan(faces.length);
+    expect(mesher.mesh().faceMeshData.faces.length).toBe(faces.length);
+    mesher.delete();
+});
+
 test("test shape", () => {
     const location = { x: 0, y: 0, z: 0 };
     const direction = { x: 0, y: 0, z: 1 };
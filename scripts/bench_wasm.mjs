@@ -0,0 +1,52 @@
+// Part of the Chili3d Project, under the AGPL-3.0 License.
+// See LICENSE file in the project root for full license information.
+
+import { execFileSync } from "node:child_process";
+import fs from "node:fs";
+import path from "node:path";
+import { fileURLToPath } from "node:url";
+
+const BENCH_DIR = path.resolve(path.dirname(fileURLToPath(import.meta.url)), "../cpp/build/target/bench");
+
+/**
+ * Runs one benchmark build and parses its "name<TAB>value" lines. Names prefixed with "ratio:" are
+ * values other than times, they keep the prefix.
+ * @param {string} name
+ * @returns {Map<string, number>}
+ */
+function runBench(name) {
+    const file = path.resolve(BENCH_DIR, `${name}.js`);
+    if (!fs.existsSync(file)) {
+        console.error(`${file} not found, run "npm run bench:wasm" first`);
+        process.exit(1);
+    }
+    const output = execFileSync(process.execPath, [file], { encoding: "utf8" });
+    const result = new Map();
+    for (const line of output.split("\n")) {
+        const [key, value] = line.split("\t");
+        if (key && value !== undefined) {
+            result.set(key, Number(value));
+        }
+    }
+    return result;
+}
+
+const single = runBench("chili-bench");
+const multi = runBench("chili-bench-mt");
+
+console.log(`threads: ${single.get("threads")} vs ${multi.get("threads")}`);
+const rows = [];
+const ratios = [];
+for (const [name, value] of single) {
+    if (name === "threads" || !multi.has(name)) {
+        continue;
+    }
+    const mtValue = multi.get(name);
+    if (name.startsWith("ratio:")) {
+        ratios.push({ case: name.slice("ratio:".length), single: value, threads: mtValue });
+        continue;
+    }
+    rows.push({ case: name, "single (ms)": value, "threads (ms)": mtValue, speedup: (value / mtValue).toFixed(2) });
+}
+console.table(rows);
+console.table(ratios);